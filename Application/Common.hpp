@@ -14,8 +14,10 @@
 #include <glm/matrix.hpp>
 #pragma warning( pop )
 
+using u64 = uint64_t;
 using u32 = uint32_t;
 using i32 = int32_t;
+using u16 = uint16_t;
 using u8 = uint8_t;
 
 using vec2 = glm::vec2;
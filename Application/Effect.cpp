@@ -1,6 +1,7 @@
 #include "Effect.hpp"
 #include "ContentManager.hpp"
 #include "RenderContext.hpp"
+#include "SpriteBatch.hpp"
 
 #include <filesystem>
 #include <fstream>
@@ -22,8 +23,9 @@ Effect::Effect(RenderContext* context, const std::string_view fragmentShaderAsse
 			   const std::string_view vertexShaderAsset)
 {
 	pso = context->CreateGraphicsPipeline(GraphicsPipelineDescriptor{
-		.vertexShaderCode = { LoadText(vertexShaderAsset), vertexShaderAsset.data() },
-		.fragmentShaderCode = { LoadText(fragmentShaderAsset), fragmentShaderAsset.data() },
+		.vertexShaderCode = { LoadText(vertexShaderAsset), vertexShaderAsset.data(), SpriteBatch::GetShaderDefines() },
+		.fragmentShaderCode = { LoadText(fragmentShaderAsset), fragmentShaderAsset.data(),
+								SpriteBatch::GetShaderDefines() },
 		.debugName = "DefaultSpriteBatchPipeline" });
 }
 
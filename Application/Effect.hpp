@@ -80,6 +80,11 @@ public:
 	void SetUniformTexture(const std::string_view uniformTextureName, const Texture2DHandle texture);
 	void SetUniformBlock(const std::string_view uniformBlockName, UniformBlock uniformBlock);
 
+protected:
+	// the DefaultSpriteBatch shaders implement every SpriteBatch option, custom ones only the subset listed at
+	// SpriteBatch::Begin()
+	bool usesDefaultShaders{ false };
+
 private:
 	friend SpriteBatch;
 	FramebufferHandle fbo{};
@@ -92,6 +97,7 @@ struct DefaultSpriteBatchEffect : Effect
 	DefaultSpriteBatchEffect(RenderContext* context)
 		: Effect{ context, "Shaders/DefaultSpriteBatch.frag", "Shaders/DefaultSpriteBatch.vert" }
 	{
+		usesDefaultShaders = true;
 	}
 };
 
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+
+#include "Common.hpp"
+
+// gpu time of a named pass, see RenderContext::BeginGpuPass()
+struct GpuPassTime
+{
+	const char* name{ "" };
+	f32 milliseconds{ 0.0f };
+};
+
+/*
+	Render counters of one frame. RenderContext::BeginFrame() moves the counters of the finished frame into a
+	rolling history and starts the next frame from zero. The counters cover the SpriteBatch passes, every
+	SpriteBatch adds its pass counters to the frame of its RenderContext at End() and keeps its own share as well.
+*/
+struct FrameStats
+{
+	// sprites drawn by End(), immediate flushes and StaticSpriteCache draws, culled ones excluded
+	u32 spritesSubmitted{ 0 };
+	u32 spritesCulled{ 0 };
+	// draw commands, one per run of sprites sharing texture and blend state
+	u32 batches{ 0 };
+	// glMultiDrawElementsIndirect calls, one per run of batches sharing the blend function and up to
+	// SpriteBatch::textureSlotCount texture arrays
+	u32 drawCalls{ 0 };
+	// state cache calls that reached GL, redundant ones excluded
+	u32 stateChanges{ 0 };
+	// vertices or sprite records, draw commands and constants written into the streaming rings
+	u64 bytesUploaded{ 0 };
+	f32 endCpuMilliseconds{ 0.0f };
+
+	// summed per pass name, the times arrive RenderContext::gpuQueryLatency or more frames after the frame
+	static constexpr u32 maxGpuPassCount = 8;
+	std::array<GpuPassTime, maxGpuPassCount> gpuPasses{};
+	u32 gpuPassCount{ 0 };
+
+	// adds the counters of other, the gpu passes are left alone
+	void Accumulate(const FrameStats& other)
+	{
+		spritesSubmitted += other.spritesSubmitted;
+		spritesCulled += other.spritesCulled;
+		batches += other.batches;
+		drawCalls += other.drawCalls;
+		stateChanges += other.stateChanges;
+		bytesUploaded += other.bytesUploaded;
+		endCpuMilliseconds += other.endCpuMilliseconds;
+	}
+};
@@ -2,7 +2,10 @@
 
 #include <SDL3/SDL.h>
 
+#include <array>
 #include <assert.h>
+#include <cfloat>
+#include <cstdio>
 #include <print>
 #include <chrono>
 
@@ -35,6 +38,49 @@ namespace
 		std::println(stderr, "GL debug message: {} type = 0x{}, severity = 0x{}, message = {}\n",
 					 (type == GL_DEBUG_TYPE_ERROR ? "** GL ERROR **" : ""), type, severity, message);
 	}
+
+	// plots value of every frame in the stats history, oldest first, with the value of overlayFramesAgo as overlay
+	template <typename Value>
+	void PlotFrameStats(const char* label, const RenderContext& renderContext, const Value& value,
+						const u32 overlayFramesAgo = 0)
+	{
+		auto values = std::array<f32, RenderContext::frameStatsHistorySize>{};
+		for (auto i = u32{ 0 }; i < RenderContext::frameStatsHistorySize; i++)
+		{
+			values[i] = value(renderContext.GetPastFrameStats(RenderContext::frameStatsHistorySize - 1 - i));
+		}
+		char overlay[32];
+		std::snprintf(overlay, sizeof(overlay), "%.3f", values[values.size() - 1 - overlayFramesAgo]);
+		ImGui::PlotLines(label, values.data(), static_cast<int>(values.size()), 0, overlay, 0.0f, FLT_MAX,
+						 ImVec2{ 0.0f, 40.0f });
+	}
+
+	void DrawFrameStatsWindow(const RenderContext& renderContext)
+	{
+		const auto& stats = renderContext.GetPastFrameStats(0);
+		ImGui::Begin("Frame Stats");
+		ImGui::Text("sprites %u, culled %u", stats.spritesSubmitted, stats.spritesCulled);
+		ImGui::Text("batches %u, draw calls %u, state changes %u", stats.batches, stats.drawCalls,
+					stats.stateChanges);
+		PlotFrameStats("End() cpu ms", renderContext,
+					   [](const FrameStats& frame) { return frame.endCpuMilliseconds; });
+		for (auto pass = u32{ 0 }; pass < stats.gpuPassCount; pass++)
+		{
+			char label[64];
+			std::snprintf(label, sizeof(label), "%s gpu ms", stats.gpuPasses[pass].name);
+			// the newest frames have no gpu times yet
+			PlotFrameStats(
+				label, renderContext,
+				[&](const FrameStats& frame)
+				{ return pass < frame.gpuPassCount ? frame.gpuPasses[pass].milliseconds : 0.0f; },
+				RenderContext::gpuQueryLatency);
+		}
+		PlotFrameStats("draw calls", renderContext,
+					   [](const FrameStats& frame) { return static_cast<f32>(frame.drawCalls); });
+		PlotFrameStats("uploaded KiB", renderContext,
+					   [](const FrameStats& frame) { return static_cast<f32>(frame.bytesUploaded) / 1024.0f; });
+		ImGui::End();
+	}
 } // namespace
 
 struct Game::GameImpl
@@ -167,6 +213,7 @@ public:
 			ImGui_ImplSDL3_NewFrame();
 			ImGui::NewFrame();
 
+			game.renderContext->BeginFrame();
 			game.OnUpdate(frameTimeInSeconds);
 			{
 				ZoneScopedNS("Draw", 30);
@@ -175,10 +222,13 @@ public:
 			}
 
 			ImGui::LabelText("Delta Time", "%f", frameTimeInSeconds);
+			DrawFrameStatsWindow(*game.renderContext);
 			ImGui::Render();
 			
 			//glFinish();
 			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+			// the ImGui backend binds its own objects behind the back of the state cache
+			game.renderContext->GetStateCache().Invalidate();
 			SDL_GL_SwapWindow(window);
 			FrameMark;
 		}
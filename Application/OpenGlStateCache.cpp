@@ -0,0 +1,203 @@
+#include "OpenGlStateCache.hpp"
+
+#include <assert.h>
+
+void OpenGlStateCache::Invalidate()
+{
+	framebuffer.reset();
+	viewport.reset();
+	clipControl.reset();
+	frontFace.reset();
+	cullFace.reset();
+	capabilities.clear();
+	blendFunc.reset();
+	depthFunc.reset();
+	depthMask.reset();
+	clearColor.reset();
+	programPipeline.reset();
+	vertexArray.reset();
+	buffers.clear();
+	bufferRanges.clear();
+	textureUnits.fill(std::nullopt);
+	samplerUnits.fill(std::nullopt);
+}
+
+void OpenGlStateCache::BindFramebuffer(const GLuint framebuffer)
+{
+	if (Update(this->framebuffer, framebuffer))
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	}
+}
+
+void OpenGlStateCache::Viewport(const GLint x, const GLint y, const GLsizei width, const GLsizei height)
+{
+	if (Update(viewport, std::array<GLint, 4>{ x, y, width, height }))
+	{
+		glViewport(x, y, width, height);
+	}
+}
+
+void OpenGlStateCache::ClipControl(const GLenum origin, const GLenum depth)
+{
+	if (Update(clipControl, std::array<GLenum, 2>{ origin, depth }))
+	{
+		glClipControl(origin, depth);
+	}
+}
+
+void OpenGlStateCache::FrontFace(const GLenum mode)
+{
+	if (Update(frontFace, mode))
+	{
+		glFrontFace(mode);
+	}
+}
+
+void OpenGlStateCache::CullFace(const GLenum mode)
+{
+	if (Update(cullFace, mode))
+	{
+		glCullFace(mode);
+	}
+}
+
+void OpenGlStateCache::SetEnabled(const GLenum capability, const bool enabled)
+{
+	if (Update(capabilities[capability], enabled))
+	{
+		if (enabled)
+		{
+			glEnable(capability);
+		}
+		else
+		{
+			glDisable(capability);
+		}
+	}
+}
+
+void OpenGlStateCache::BlendFunc(const GLenum sourceFactor, const GLenum destinationFactor)
+{
+	if (Update(blendFunc, std::array<GLenum, 2>{ sourceFactor, destinationFactor }))
+	{
+		glBlendFunc(sourceFactor, destinationFactor);
+	}
+}
+
+void OpenGlStateCache::DepthFunc(const GLenum function)
+{
+	if (Update(depthFunc, function))
+	{
+		glDepthFunc(function);
+	}
+}
+
+void OpenGlStateCache::DepthMask(const bool enabled)
+{
+	if (Update(depthMask, enabled))
+	{
+		glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+	}
+}
+
+void OpenGlStateCache::ClearColor(const f32 red, const f32 green, const f32 blue, const f32 alpha)
+{
+	if (Update(clearColor, std::array<f32, 4>{ red, green, blue, alpha }))
+	{
+		glClearColor(red, green, blue, alpha);
+	}
+}
+
+void OpenGlStateCache::BindProgramPipeline(const GLuint pipeline)
+{
+	if (Update(programPipeline, pipeline))
+	{
+		glBindProgramPipeline(pipeline);
+	}
+}
+
+void OpenGlStateCache::BindVertexArray(const GLuint vertexArray)
+{
+	if (Update(this->vertexArray, vertexArray))
+	{
+		glBindVertexArray(vertexArray);
+	}
+}
+
+void OpenGlStateCache::BindBuffer(const GLenum target, const GLuint buffer)
+{
+	assert(target != GL_ELEMENT_ARRAY_BUFFER);
+	if (Update(buffers[target], buffer))
+	{
+		glBindBuffer(target, buffer);
+	}
+}
+
+void OpenGlStateCache::BindBufferRange(const GLenum target, const GLuint index, const GLuint buffer,
+									   const GLintptr offset, const GLsizeiptr size)
+{
+	const auto key = (static_cast<u64>(target) << 32) | index;
+	if (Update(bufferRanges[key], BufferRange{ buffer, offset, size }))
+	{
+		glBindBufferRange(target, index, buffer, offset, size);
+	}
+}
+
+void OpenGlStateCache::BindBufferBase(const GLenum target, const GLuint index, const GLuint buffer)
+{
+	// a whole buffer binding is recorded as a range of size 0, which glBindBufferRange never accepts
+	const auto key = (static_cast<u64>(target) << 32) | index;
+	if (Update(bufferRanges[key], BufferRange{ buffer, 0, 0 }))
+	{
+		glBindBufferBase(target, index, buffer);
+	}
+}
+
+void OpenGlStateCache::BindTextureUnit(const GLuint unit, const GLuint texture)
+{
+	assert(unit < trackedUnitCount);
+	if (Update(textureUnits[unit], texture))
+	{
+		glBindTextureUnit(unit, texture);
+	}
+}
+
+void OpenGlStateCache::BindTextures(const GLuint first, const GLsizei count, const GLuint* textures)
+{
+	if (UpdateUnits(textureUnits, first, count, textures))
+	{
+		glBindTextures(first, count, textures);
+	}
+}
+
+void OpenGlStateCache::BindSamplers(const GLuint first, const GLsizei count, const GLuint* samplers)
+{
+	if (UpdateUnits(samplerUnits, first, count, samplers))
+	{
+		glBindSamplers(first, count, samplers);
+	}
+}
+
+bool OpenGlStateCache::UpdateUnits(std::array<std::optional<GLuint>, trackedUnitCount>& current, const GLuint first,
+								   const GLsizei count, const GLuint* names)
+{
+	assert(first + count <= trackedUnitCount);
+	auto changed = false;
+	for (auto unit = GLuint{ 0 }; unit < static_cast<GLuint>(count); unit++)
+	{
+		const auto name = names ? names[unit] : GLuint{ 0 };
+		changed = changed or current[first + unit] != name;
+		current[first + unit] = name;
+	}
+	// a multi bind is one call, it is either issued as a whole or dropped as a whole
+	if (changed)
+	{
+		statistics.issuedCalls++;
+	}
+	else
+	{
+		statistics.redundantCalls++;
+	}
+	return changed;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <unordered_map>
+
+#include "Common.hpp"
+
+struct OpenGlStateStatistics
+{
+	u64 issuedCalls{ 0 };
+	u64 redundantCalls{ 0 };
+};
+
+/*
+	Shadow copy of the GL state the renderer touches. Every binding and fixed function state change goes through
+	the cache, calls that would set the value the context already holds are dropped and counted. State changed by
+	code outside the renderer, e.g. the ImGui backend, is unknown to the cache, Invalidate() has to be called
+	afterwards so the next call of each kind is issued again.
+*/
+struct OpenGlStateCache
+{
+	void Invalidate();
+
+	void BindFramebuffer(const GLuint framebuffer);
+	void Viewport(const GLint x, const GLint y, const GLsizei width, const GLsizei height);
+	void ClipControl(const GLenum origin, const GLenum depth);
+	void FrontFace(const GLenum mode);
+	void CullFace(const GLenum mode);
+	void SetEnabled(const GLenum capability, const bool enabled);
+	void BlendFunc(const GLenum sourceFactor, const GLenum destinationFactor);
+	void DepthFunc(const GLenum function);
+	void DepthMask(const bool enabled);
+	void ClearColor(const f32 red, const f32 green, const f32 blue, const f32 alpha);
+
+	void BindProgramPipeline(const GLuint pipeline);
+	void BindVertexArray(const GLuint vertexArray);
+	// only for binding points that are not part of the vertex array state, e.g. GL_DRAW_INDIRECT_BUFFER
+	void BindBuffer(const GLenum target, const GLuint buffer);
+	void BindBufferRange(const GLenum target, const GLuint index, const GLuint buffer, const GLintptr offset,
+						 const GLsizeiptr size);
+	void BindBufferBase(const GLenum target, const GLuint index, const GLuint buffer);
+	void BindTextureUnit(const GLuint unit, const GLuint texture);
+	// textures and samplers may be nullptr to unbind count units
+	void BindTextures(const GLuint first, const GLsizei count, const GLuint* textures);
+	void BindSamplers(const GLuint first, const GLsizei count, const GLuint* samplers);
+
+	OpenGlStateStatistics GetStatistics() const
+	{
+		return statistics;
+	}
+
+	static constexpr u32 trackedUnitCount = 32;
+
+private:
+	// counts the call and returns true if it has to be issued
+	template <typename T>
+	bool Update(std::optional<T>& current, const T& value)
+	{
+		if (current == value)
+		{
+			statistics.redundantCalls++;
+			return false;
+		}
+		current = value;
+		statistics.issuedCalls++;
+		return true;
+	}
+	bool UpdateUnits(std::array<std::optional<GLuint>, trackedUnitCount>& current, const GLuint first,
+					 const GLsizei count, const GLuint* names);
+
+	struct BufferRange
+	{
+		GLuint buffer;
+		GLintptr offset;
+		GLsizeiptr size;
+
+		bool operator==(const BufferRange&) const = default;
+	};
+
+	std::optional<GLuint> framebuffer;
+	std::optional<std::array<GLint, 4>> viewport;
+	std::optional<std::array<GLenum, 2>> clipControl;
+	std::optional<GLenum> frontFace;
+	std::optional<GLenum> cullFace;
+	std::unordered_map<GLenum, std::optional<bool>> capabilities;
+	std::optional<std::array<GLenum, 2>> blendFunc;
+	std::optional<GLenum> depthFunc;
+	std::optional<bool> depthMask;
+	std::optional<std::array<f32, 4>> clearColor;
+	std::optional<GLuint> programPipeline;
+	std::optional<GLuint> vertexArray;
+	std::unordered_map<GLenum, std::optional<GLuint>> buffers;
+	// keyed by target in the high and index in the low half
+	std::unordered_map<u64, std::optional<BufferRange>> bufferRanges;
+	std::array<std::optional<GLuint>, trackedUnitCount> textureUnits{};
+	std::array<std::optional<GLuint>, trackedUnitCount> samplerUnits{};
+
+	OpenGlStateStatistics statistics{};
+};
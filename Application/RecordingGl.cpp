@@ -0,0 +1,209 @@
+#include "RecordingGl.hpp"
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	auto counters = RecordingGlCounters{};
+	auto nextName = GLuint{ 1 };
+	// system memory behind the buffers created with map access, indexed by buffer name
+	auto mappableBuffers = std::unordered_map<GLuint, std::vector<std::byte>>{};
+
+	void GenerateNames(const GLsizei count, GLuint* names)
+	{
+		counters.calls++;
+		for (auto i = GLsizei{ 0 }; i < count; i++)
+		{
+			names[i] = nextName++;
+		}
+	}
+
+	// replaces function by a stub that only counts the call, also into category if given, and returns zero
+	template <u64 RecordingGlCounters::*category = nullptr, typename Result, typename... Arguments>
+	void Record(Result(APIENTRYP& function)(Arguments...))
+	{
+		function = [](Arguments...) -> Result
+		{
+			counters.calls++;
+			if constexpr (category != nullptr)
+			{
+				counters.*category += 1;
+			}
+			return Result();
+		};
+	}
+} // namespace
+
+RecordingGlCounters& GetRecordingGlCounters()
+{
+	return counters;
+}
+
+void InstallRecordingGl()
+{
+	// object creation hands out fresh names, deletion is ignored
+	glCreateBuffers = [](GLsizei n, GLuint* buffers) { GenerateNames(n, buffers); };
+	glCreateVertexArrays = [](GLsizei n, GLuint* arrays) { GenerateNames(n, arrays); };
+	glCreateFramebuffers = [](GLsizei n, GLuint* framebuffers) { GenerateNames(n, framebuffers); };
+	glCreateProgramPipelines = [](GLsizei n, GLuint* pipelines) { GenerateNames(n, pipelines); };
+	glCreateSamplers = [](GLsizei n, GLuint* samplers) { GenerateNames(n, samplers); };
+	glGenTextures = [](GLsizei n, GLuint* textures) { GenerateNames(n, textures); };
+	glCreateTextures = [](GLenum, GLsizei n, GLuint* textures) { GenerateNames(n, textures); };
+	glCreateQueries = [](GLenum, GLsizei n, GLuint* ids) { GenerateNames(n, ids); };
+	glGenQueries = [](GLsizei n, GLuint* ids) { GenerateNames(n, ids); };
+	glCreateShaderProgramv = [](GLenum, GLsizei, const GLchar* const*)
+	{
+		counters.calls++;
+		return nextName++;
+	};
+	Record(glDeleteBuffers);
+	Record(glDeleteVertexArrays);
+	Record(glDeleteFramebuffers);
+	Record(glDeleteProgramPipelines);
+	Record(glDeleteProgram);
+	Record(glDeleteSamplers);
+	Record(glDeleteTextures);
+	Record(glDeleteQueries);
+	Record(glDeleteSync);
+	Record(glObjectLabel);
+
+	// buffers that are mapped get system memory, the streaming rings write straight into it
+	glNamedBufferStorage = [](GLuint buffer, GLsizeiptr size, const void*, GLbitfield flags)
+	{
+		counters.calls++;
+		if (flags & (GL_MAP_READ_BIT | GL_MAP_WRITE_BIT))
+		{
+			mappableBuffers[buffer].resize(static_cast<size_t>(size));
+		}
+	};
+	glMapNamedBufferRange = [](GLuint buffer, GLintptr offset, GLsizeiptr, GLbitfield) -> void*
+	{
+		counters.calls++;
+		return mappableBuffers.at(buffer).data() + offset;
+	};
+	glUnmapNamedBuffer = [](GLuint buffer) -> GLboolean
+	{
+		counters.calls++;
+		mappableBuffers.erase(buffer);
+		return GL_TRUE;
+	};
+
+	// the gpu is always done, fences never block
+	glFenceSync = [](GLenum, GLbitfield)
+	{
+		counters.calls++;
+		return reinterpret_cast<GLsync>(static_cast<uintptr_t>(nextName++));
+	};
+	glClientWaitSync = [](GLsync, GLbitfield, GLuint64) -> GLenum
+	{
+		counters.calls++;
+		return GL_ALREADY_SIGNALED;
+	};
+	Record(glFlush);
+	Record(glFinish);
+
+	glGetIntegerv = [](GLenum pname, GLint* data)
+	{
+		counters.calls++;
+		switch (pname)
+		{
+		case GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT:
+		case GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT:
+			*data = 256;
+			break;
+		default:
+			*data = 0;
+			break;
+		}
+	};
+	glGetProgramiv = [](GLuint, GLenum, GLint* params)
+	{
+		counters.calls++;
+		*params = GL_TRUE;
+	};
+	Record(glGetProgramInfoLog);
+	Record(glBeginQuery);
+	Record(glEndQuery);
+	Record(glQueryCounter);
+	glGetInteger64v = [](GLenum, GLint64* data)
+	{
+		counters.calls++;
+		*data = 0;
+	};
+	// the timestamp queries of the Tracy gpu context ask for the counter width
+	glGetQueryiv = [](GLenum, GLenum, GLint* params)
+	{
+		counters.calls++;
+		*params = 64;
+	};
+	glGetQueryObjectiv = [](GLuint, GLenum pname, GLint* params)
+	{
+		counters.calls++;
+		*params = pname == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+	};
+	glGetQueryObjectuiv = [](GLuint, GLenum pname, GLuint* params)
+	{
+		counters.calls++;
+		*params = pname == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+	};
+	glGetQueryObjectui64v = [](GLuint, GLenum, GLuint64* params)
+	{
+		counters.calls++;
+		*params = 0;
+	};
+
+	// resource setup
+	Record(glTextureStorage2D);
+	Record(glTextureStorage3D);
+	Record(glTextureView);
+	Record(glTextureParameteri);
+	Record(glCompressedTextureSubImage2D);
+	Record(glCopyImageSubData);
+	Record(glSamplerParameteri);
+	Record(glUseProgramStages);
+	Record(glNamedFramebufferTexture);
+	Record(glVertexArrayVertexBuffer);
+	Record(glVertexArrayElementBuffer);
+	Record(glVertexArrayAttribFormat);
+	Record(glVertexArrayAttribBinding);
+	Record(glEnableVertexArrayAttrib);
+	Record(glClearNamedFramebufferfv);
+	Record(glClearNamedFramebufferfi);
+	Record(glClear);
+
+	Record<&RecordingGlCounters::bindCalls>(glBindBuffer);
+	Record<&RecordingGlCounters::bindCalls>(glBindBufferBase);
+	Record<&RecordingGlCounters::bindCalls>(glBindBufferRange);
+	Record<&RecordingGlCounters::bindCalls>(glBindFramebuffer);
+	Record<&RecordingGlCounters::bindCalls>(glBindProgramPipeline);
+	Record<&RecordingGlCounters::bindCalls>(glBindSamplers);
+	Record<&RecordingGlCounters::bindCalls>(glBindTextureUnit);
+	Record<&RecordingGlCounters::bindCalls>(glBindTextures);
+	Record<&RecordingGlCounters::bindCalls>(glBindVertexArray);
+
+	Record<&RecordingGlCounters::stateCalls>(glEnable);
+	Record<&RecordingGlCounters::stateCalls>(glDisable);
+	Record<&RecordingGlCounters::stateCalls>(glBlendFunc);
+	Record<&RecordingGlCounters::stateCalls>(glDepthFunc);
+	Record<&RecordingGlCounters::stateCalls>(glDepthMask);
+	Record<&RecordingGlCounters::stateCalls>(glClipControl);
+	Record<&RecordingGlCounters::stateCalls>(glFrontFace);
+	Record<&RecordingGlCounters::stateCalls>(glCullFace);
+	Record<&RecordingGlCounters::stateCalls>(glViewport);
+	Record<&RecordingGlCounters::stateCalls>(glClearColor);
+
+	glMultiDrawElementsIndirect = [](GLenum, GLenum, const void*, GLsizei drawcount, GLsizei)
+	{
+		counters.calls++;
+		counters.drawCalls++;
+		counters.drawCommands += static_cast<u64>(drawcount);
+	};
+	glDrawArraysInstancedBaseInstance = [](GLenum, GLint, GLsizei, GLsizei, GLuint)
+	{
+		counters.calls++;
+		counters.drawCalls++;
+		counters.drawCommands++;
+	};
+}
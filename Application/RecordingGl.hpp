@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Common.hpp"
+
+/*
+	Headless stand-in for the OpenGL driver, used by SpriteBatchBench. InstallRecordingGl() points the glad function
+	pointers the renderer calls at stubs that count the calls instead of executing them: object names are handed out
+	from a counter, mappable buffer storage lives in system memory, fences are always signaled and programs always
+	link. RenderContext and SpriteBatch run unchanged on top of it without a window or a context.
+*/
+struct RecordingGlCounters
+{
+	u64 calls{ 0 };
+	// glMultiDrawElementsIndirect and glDrawArraysInstancedBaseInstance calls and the draws they issue
+	u64 drawCalls{ 0 };
+	u64 drawCommands{ 0 };
+	u64 bindCalls{ 0 };
+	// enable, blend, depth, viewport and the other fixed function state
+	u64 stateCalls{ 0 };
+};
+
+void InstallRecordingGl();
+RecordingGlCounters& GetRecordingGlCounters();
@@ -2,10 +2,15 @@
 #include "Color.hpp"
 #include "ContentManager.hpp"
 
+#include <algorithm>
 #include <assert.h>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <sstream>
+#include <string_view>
+
+#include <tracy/TracyOpenGL.hpp>
 
 namespace
 {
@@ -16,6 +21,8 @@ namespace
 		{
 		case TextureFormat::rgba8:
 			return GL_RGBA8;
+		case TextureFormat::r32f:
+			return GL_R32F;
 		case TextureFormat::d32f:
 			return GL_DEPTH_COMPONENT32F;
 		case TextureFormat::bc_rgba_unorm:
@@ -24,6 +31,32 @@ namespace
 		return 0;
 	}
 
+	GLint mapToGlFilter(const SamplerFilter filter)
+	{
+		switch (filter)
+		{
+		case SamplerFilter::nearest:
+			return GL_NEAREST;
+		case SamplerFilter::linear:
+			return GL_LINEAR;
+		}
+		return 0;
+	}
+
+	GLint mapToGlAddressMode(const SamplerAddressMode addressMode)
+	{
+		switch (addressMode)
+		{
+		case SamplerAddressMode::repeat:
+			return GL_REPEAT;
+		case SamplerAddressMode::mirroredRepeat:
+			return GL_MIRRORED_REPEAT;
+		case SamplerAddressMode::clampToEdge:
+			return GL_CLAMP_TO_EDGE;
+		}
+		return 0;
+	}
+
 	u32 keyGenerator{ 0 };
 
 	u32 GenerateKey()
@@ -39,6 +72,29 @@ namespace
 		stream << file.rdbuf();
 		return TextAsset{ stream.str() };
 	}
+
+	GLuint CreateShaderProgram(const GLenum stage, const ShaderCode& shaderCode)
+	{
+		const auto& code = shaderCode.code;
+		auto program = GLuint{ 0 };
+		if (shaderCode.defines.empty())
+		{
+			const auto sources = std::array{ code.c_str() };
+			program = glCreateShaderProgramv(stage, 1, sources.data());
+		}
+		else
+		{
+			// #version has to stay the first line, #line keeps the compiler messages at the lines of the file
+			const auto lineEnd = code.find('\n');
+			const auto versionEnd = lineEnd == std::string::npos ? code.size() : lineEnd + 1;
+			const auto version = code.substr(0, versionEnd);
+			const auto sources =
+				std::array{ version.c_str(), shaderCode.defines.c_str(), "#line 2\n", code.c_str() + versionEnd };
+			program = glCreateShaderProgramv(stage, static_cast<GLsizei>(sources.size()), sources.data());
+		}
+		glObjectLabel(GL_PROGRAM, program, glLabel(shaderCode.debugName));
+		return program;
+	}
 } // namespace
 
 Framebuffer RenderContext::CreateOpenGlFramebuffer(const FramebufferDescriptor& descriptor)
@@ -109,45 +165,251 @@ RenderContext::RenderContext(const u32 width, const u32 height)
 												.format = TextureFormat::d32f,
 												.debugName = "default_depth_render_target" },
 		.debugName = "default_fb" });
+
+	overdrawHeatmapPipeline = CreateGraphicsPipeline(GraphicsPipelineDescriptor{
+		.vertexShaderCode = { LoadText("Shaders/FullscreenBlit.vert"), "Shaders/FullscreenBlit.vert" },
+		.fragmentShaderCode = { LoadText("Shaders/OverdrawHeatmap.frag"), "Shaders/OverdrawHeatmap.frag" },
+		.debugName = "overdrawHeatmapPipeline" });
+
+	glCreateQueries(GL_SAMPLES_PASSED, 1, &overdrawQuery);
+	for (auto& query : gpuQueries)
+	{
+		glCreateQueries(GL_TIME_ELAPSED, 1, &query.query);
+	}
+	TracyGpuContext;
+	TracyGpuContextName("RenderContext", 13);
 }
 
 RenderContext::~RenderContext()
 {
+	for (const auto& query : gpuQueries)
+	{
+		glDeleteQueries(1, &query.query);
+	}
+	glDeleteQueries(1, &overdrawQuery);
+	if (overdrawFramebuffer)
+	{
+		DestroyFramebuffer(*overdrawFramebuffer);
+	}
+	DestroyGraphicsPipeline(overdrawHeatmapPipeline);
 	DestroyFramebuffer(defaultFramebuffer);
 	DestroyGraphicsPipeline(fullscreenQuadPipeline);
 }
 
 void RenderContext::Blit()
 {
+	const auto gpuPass = GpuPassScope{ *this, "Blit" };
 	const auto& framebuffer = Get(defaultFramebuffer);
 	const auto& colorTexture = Get(framebuffer.colorAttachment[0]);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glViewport(0, 0, windowContext.width, windowContext.height);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glBindProgramPipeline(Get(fullscreenQuadPipeline).nativeHandle);
-	glBindTextureUnit(0, colorTexture.nativeHandle);
+	stateCache.BindFramebuffer(0);
+	stateCache.Viewport(0, 0, windowContext.width, windowContext.height);
+	stateCache.SetEnabled(GL_BLEND, true);
+	stateCache.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	stateCache.BindProgramPipeline(Get(fullscreenQuadPipeline).nativeHandle);
+	stateCache.BindTextureUnit(0, colorTexture.nativeHandle);
 	glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 3, 1, 0);
-	glDisable(GL_BLEND);
+	stateCache.SetEnabled(GL_BLEND, false);
 }
 
 void RenderContext::Blit(const FramebufferHandle from, const u32 index)
 {
+	const auto gpuPass = GpuPassScope{ *this, "Blit" };
 	assert(index == 0);
 	const auto& framebuffer = Get(from);
 	const auto& colorTexture = Get(framebuffer.colorAttachment[index]);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glViewport(0, 0, windowContext.width, windowContext.height);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glBindProgramPipeline(Get(fullscreenQuadPipeline).nativeHandle);
-	glBindTextureUnit(0, colorTexture.nativeHandle);
+	stateCache.BindFramebuffer(0);
+	stateCache.Viewport(0, 0, windowContext.width, windowContext.height);
+	stateCache.SetEnabled(GL_BLEND, true);
+	stateCache.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	stateCache.BindProgramPipeline(Get(fullscreenQuadPipeline).nativeHandle);
+	stateCache.BindTextureUnit(0, colorTexture.nativeHandle);
+	glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 3, 1, 0);
+	stateCache.SetEnabled(GL_BLEND, false);
+}
+
+FramebufferHandle RenderContext::GetOverdrawFramebuffer()
+{
+	// only debugging sessions pay for the window sized count and depth targets
+	if (not overdrawFramebuffer)
+	{
+		overdrawFramebuffer = CreateFramebuffer(FramebufferDescriptor{
+			.colorAttachment = { Texture2DDescriptor{ .extent = DynamicExtent{},
+													  .format = TextureFormat::r32f,
+													  .debugName = "overdraw_count_render_target" } },
+			.depthAttachment = Texture2DDescriptor{ .extent = DynamicExtent{},
+													.format = TextureFormat::d32f,
+													.debugName = "overdraw_depth_render_target" },
+			.debugName = "overdraw_fb" });
+	}
+	return *overdrawFramebuffer;
+}
+
+void RenderContext::BeginOverdrawCapture()
+{
+	assert(not isCapturingOverdraw);
+	const auto& framebuffer = Get(GetOverdrawFramebuffer());
+	const auto zero = 0.0f;
+	const auto clearCount = std::array{ 0.0f, 0.0f, 0.0f, 0.0f };
+	stateCache.DepthMask(true);
+	glClearNamedFramebufferfv(framebuffer.nativeHandle, GL_COLOR, 0, clearCount.data());
+	glClearNamedFramebufferfv(framebuffer.nativeHandle, GL_DEPTH, 0, &zero);
+
+	// a query still in flight is not restarted, the capture only updates the heatmap then
+	ResolveOverdrawQuery();
+	if (not isOverdrawQueryPending)
+	{
+		glBeginQuery(GL_SAMPLES_PASSED, overdrawQuery);
+		isOverdrawQueryPending = true;
+		isOverdrawQueryActive = true;
+	}
+	isCapturingOverdraw = true;
+}
+
+void RenderContext::EndOverdrawCapture()
+{
+	assert(isCapturingOverdraw);
+	if (isOverdrawQueryActive)
+	{
+		glEndQuery(GL_SAMPLES_PASSED);
+		const auto& countTexture = Get(Get(GetOverdrawFramebuffer()).colorAttachment[0]);
+		overdrawQueryPixelCount = static_cast<u64>(countTexture.width) * countTexture.height;
+		isOverdrawQueryActive = false;
+	}
+	isCapturingOverdraw = false;
+}
+
+f32 RenderContext::GetAverageOverdraw()
+{
+	ResolveOverdrawQuery();
+	return averageOverdraw;
+}
+
+void RenderContext::ResolveOverdrawQuery()
+{
+	if (not isOverdrawQueryPending or isOverdrawQueryActive)
+	{
+		return;
+	}
+	auto isAvailable = GLuint{ GL_FALSE };
+	glGetQueryObjectuiv(overdrawQuery, GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+	if (isAvailable == GL_TRUE)
+	{
+		auto samplesPassed = GLuint64{};
+		glGetQueryObjectui64v(overdrawQuery, GL_QUERY_RESULT, &samplesPassed);
+		averageOverdraw =
+			static_cast<f32>(samplesPassed) / static_cast<f32>(std::max(overdrawQueryPixelCount, u64{ 1 }));
+		isOverdrawQueryPending = false;
+	}
+}
+
+void RenderContext::BeginFrame()
+{
+	assert(gpuPassDepth == 0);
+	frameStats.gpuPassCount = static_cast<u32>(gpuPassNames.size());
+	for (auto i = size_t{ 0 }; i < gpuPassNames.size(); i++)
+	{
+		frameStats.gpuPasses[i] = GpuPassTime{ gpuPassNames[i], 0.0f };
+	}
+	frameStatsHistory[frameStatsHistoryHead] = frameStats;
+	frameStatsHistoryHead = (frameStatsHistoryHead + 1) % frameStatsHistorySize;
+	frameStats = FrameStats{};
+	frameIndex++;
+	ResolveGpuPassQueries();
+	TracyGpuCollect;
+}
+
+void RenderContext::BeginGpuPass(const char* name)
+{
+	if (gpuPassDepth++ > 0)
+	{
+		return;
+	}
+	auto pass = std::find_if(gpuPassNames.begin(), gpuPassNames.end(),
+							 [&](const char* candidate) { return std::string_view{ candidate } == name; });
+	if (pass == gpuPassNames.end())
+	{
+		assert(gpuPassNames.size() < FrameStats::maxGpuPassCount);
+		pass = gpuPassNames.insert(gpuPassNames.end(), name);
+	}
+	// an exhausted pool means the read back is behind, the pass is dropped instead of waiting for a query
+	if (gpuQueryHead - gpuQueryTail < gpuQueryPoolSize)
+	{
+		auto& query = gpuQueries[gpuQueryHead % gpuQueryPoolSize];
+		query.pass = static_cast<u32>(pass - gpuPassNames.begin());
+		query.frame = frameIndex;
+		glBeginQuery(GL_TIME_ELAPSED, query.query);
+		isGpuQueryActive = true;
+	}
+#ifdef TRACY_ENABLE
+	tracyGpuZone.emplace(__LINE__, __FILE__, std::strlen(__FILE__), __func__, std::strlen(__func__), name,
+						 std::strlen(name), true);
+#endif
+}
+
+void RenderContext::EndGpuPass()
+{
+	assert(gpuPassDepth > 0);
+	if (--gpuPassDepth > 0)
+	{
+		return;
+	}
+#ifdef TRACY_ENABLE
+	tracyGpuZone.reset();
+#endif
+	if (isGpuQueryActive)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		gpuQueryHead++;
+		isGpuQueryActive = false;
+	}
+}
+
+void RenderContext::ResolveGpuPassQueries()
+{
+	while (gpuQueryTail != gpuQueryHead)
+	{
+		const auto& query = gpuQueries[gpuQueryTail % gpuQueryPoolSize];
+		if (query.frame + gpuQueryLatency > frameIndex)
+		{
+			return;
+		}
+		// queries finish in issue order, so the first one without a result ends the read back
+		auto isAvailable = GLuint{ GL_FALSE };
+		glGetQueryObjectuiv(query.query, GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+		if (isAvailable != GL_TRUE)
+		{
+			return;
+		}
+		auto nanoseconds = GLuint64{};
+		glGetQueryObjectui64v(query.query, GL_QUERY_RESULT, &nanoseconds);
+		// frameIndex - 1 is the last finished frame
+		const auto framesAgo = frameIndex - 1 - query.frame;
+		if (framesAgo < frameStatsHistorySize)
+		{
+			auto& stats = frameStatsHistory[(frameStatsHistoryHead + frameStatsHistorySize - 1 - framesAgo) %
+											frameStatsHistorySize];
+			stats.gpuPasses[query.pass].milliseconds += static_cast<f32>(nanoseconds) * 1.0e-6f;
+		}
+		gpuQueryTail++;
+	}
+}
+
+void RenderContext::BlitOverdrawHeatmap()
+{
+	const auto gpuPass = GpuPassScope{ *this, "Blit" };
+	const auto& framebuffer = Get(GetOverdrawFramebuffer());
+	const auto& countTexture = Get(framebuffer.colorAttachment[0]);
+	stateCache.BindFramebuffer(0);
+	stateCache.Viewport(0, 0, windowContext.width, windowContext.height);
+	stateCache.SetEnabled(GL_BLEND, false);
+	stateCache.BindProgramPipeline(Get(overdrawHeatmapPipeline).nativeHandle);
+	stateCache.BindTextureUnit(0, countTexture.nativeHandle);
 	glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 3, 1, 0);
-	glDisable(GL_BLEND);
 }
 
 void RenderContext::Clear(const Color& color, const FramebufferHandle framebuffer)
 {
+	const auto gpuPass = GpuPassScope{ *this, "Clear" };
 	auto framebufferHandle = FramebufferHandle{};
 	if (framebuffer == framebufferHandle)
 	{
@@ -160,14 +422,16 @@ void RenderContext::Clear(const Color& color, const FramebufferHandle framebuffe
 	const auto& fbo = Get(framebufferHandle);
 	const auto colorClearValue = std::array{ 0.0f, 0.0f, 0.0f, 0.0f };
 	glClearNamedFramebufferfv(fbo.nativeHandle, GL_COLOR, 0, colorClearValue.data());
+	// depth clears are masked by the depth write mask
+	stateCache.DepthMask(true);
 	glClearNamedFramebufferfi(fbo.nativeHandle, GL_DEPTH_STENCIL, 0, 0.0f, 0);
 	//TODO: clear dependent on framebuffer images
 
 	{
 		const auto clearColor = vec4(color.r / 255.f, color.g / 255.f, color.b / 255.f, color.a / 255.0f);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glClearColor(clearColor.x * clearColor.w, clearColor.y * clearColor.w, clearColor.z * clearColor.w,
-					 clearColor.w);
+		stateCache.BindFramebuffer(0);
+		stateCache.ClearColor(clearColor.x * clearColor.w, clearColor.y * clearColor.w, clearColor.z * clearColor.w,
+							  clearColor.w);
 		glClear(GL_COLOR_BUFFER_BIT);
 	}
 }
@@ -207,6 +471,10 @@ Texture2DHandle RenderContext::CreateTexture2D(const Texture2DDescriptor& descri
 	glTextureStorage2D(texture.nativeHandle, descriptor.levels, mapToGlFormat(descriptor.format),
 					   static_cast<GLsizei>(width), static_cast<GLsizei>(height));
 	glObjectLabel(GL_TEXTURE, texture.nativeHandle, glLabel(descriptor.debugName));
+	// render targets are never sampled as sprites, the array view is created by GetSpriteTexture() when needed
+	texture.arrayViewNativeHandle = 0;
+	texture.arrayNativeHandle = 0;
+	texture.arrayLayer = 0;
 
 	texture.width = width;
 	texture.height = height;
@@ -239,13 +507,17 @@ FramebufferHandle RenderContext::CreateFramebuffer(const FramebufferDescriptor&
 
 void RenderContext::DestroyTexture2D(const Texture2DHandle texture)
 {
+	// deleted names are unbound by GL and may be handed out again, the shadow state must not match them
+	stateCache.Invalidate();
 	const auto& textureObject = Get(texture);
+	glDeleteTextures(1, &textureObject.arrayViewNativeHandle);
 	glDeleteTextures(1, &textureObject.nativeHandle);
 	textures.erase(texture);
 }
 
 void RenderContext::DestroyOpenGlFramebuffer(const Framebuffer& framebuffer)
 {
+	stateCache.Invalidate();
 	for (auto i = 0; i < framebuffer.colorAttachment.size(); i++)
 	{
 		DestroyTexture2D(framebuffer.colorAttachment[i]);
@@ -272,6 +544,7 @@ void RenderContext::DestroyFramebuffer(const FramebufferHandle framebuffer)
 void RenderContext::UploadTextureData(const Texture2DHandle texture, const u8 level, void* data, size_t size)
 {
 	auto& nativeTexture = Get(texture);
+	assert(nativeTexture.nativeHandle != 0);
 	auto extent = glm::uvec2{ nativeTexture.width, nativeTexture.height };
 	auto mipExtent = glm::uvec2(extent >> glm::uvec2{ static_cast<u32>(level) });
 	mipExtent = glm::max(mipExtent, glm::uvec2(static_cast<u32>(1u)));
@@ -281,15 +554,151 @@ void RenderContext::UploadTextureData(const Texture2DHandle texture, const u8 le
 								  mapToGlFormat(nativeTexture.format), static_cast<GLsizei>(size), data);
 }
 
-GraphicsPipelineHandle RenderContext::CreateGraphicsPipeline(const GraphicsPipelineDescriptor& descriptor)
+std::vector<Texture2DArrayHandle> RenderContext::GroupIntoTextureArrays(std::span<const Texture2DHandle> textures,
+																		const char* debugName, const u32 maxLayers)
 {
-	const auto sourcesVertexShader = std::array{ descriptor.vertexShaderCode.code.c_str() };
-	const auto sourcesFragmentShader = std::array{ descriptor.fragmentShaderCode.code.c_str() };
+	assert(maxLayers <= maxTextureArrayLayers);
+	auto groups = std::vector<std::vector<Texture2DHandle>>{};
+	for (const auto texture : textures)
+	{
+		const auto isDuplicate =
+			std::any_of(groups.begin(), groups.end(), [&](const std::vector<Texture2DHandle>& group)
+						{ return std::find(group.begin(), group.end(), texture) != group.end(); });
+		if (isDuplicate)
+		{
+			continue;
+		}
+
+		const auto& textureObject = Get(texture);
+		const auto group = std::find_if(groups.begin(), groups.end(),
+										[&](const std::vector<Texture2DHandle>& candidate)
+										{
+											const auto& first = Get(candidate.front());
+											return candidate.size() < maxLayers and
+												first.format == textureObject.format and
+												first.width == textureObject.width and
+												first.height == textureObject.height and
+												first.levels == textureObject.levels;
+										});
+		if (group == groups.end())
+		{
+			groups.push_back({ texture });
+		}
+		else
+		{
+			group->push_back(texture);
+		}
+	}
 
-	const auto vertexProgram = glCreateShaderProgramv(GL_VERTEX_SHADER, 1, sourcesVertexShader.data());
-	glObjectLabel(GL_PROGRAM, vertexProgram, glLabel(descriptor.vertexShaderCode.debugName));
-	const auto fragmentProgram = glCreateShaderProgramv(GL_FRAGMENT_SHADER, 1, sourcesFragmentShader.data());
-	glObjectLabel(GL_PROGRAM, fragmentProgram, glLabel(descriptor.fragmentShaderCode.debugName));
+	auto arrays = std::vector<Texture2DArrayHandle>{};
+	for (const auto& group : groups)
+	{
+		if (group.size() < 2)
+		{
+			continue;
+		}
+
+		const auto& first = Get(group.front());
+		auto textureArray = Texture2DArray{ .nativeHandle = 0,
+											.width = first.width,
+											.height = first.height,
+											.format = first.format,
+											.levels = first.levels,
+											.layers = group };
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &textureArray.nativeHandle);
+		glTextureParameteri(textureArray.nativeHandle, GL_TEXTURE_BASE_LEVEL, 0);
+		glTextureParameteri(textureArray.nativeHandle, GL_TEXTURE_MAX_LEVEL, 0);
+		glTextureStorage3D(textureArray.nativeHandle, textureArray.levels, mapToGlFormat(textureArray.format),
+						   static_cast<GLsizei>(textureArray.width), static_cast<GLsizei>(textureArray.height),
+						   static_cast<GLsizei>(group.size()));
+		glObjectLabel(GL_TEXTURE, textureArray.nativeHandle, glLabel(debugName));
+
+		for (auto layer = u32{ 0 }; layer < group.size(); layer++)
+		{
+			auto& texture = Get(group[layer]);
+			for (auto level = u32{ 0 }; level < textureArray.levels; level++)
+			{
+				const auto mipExtent =
+					glm::max(glm::uvec2{ texture.width, texture.height } >> glm::uvec2{ level }, glm::uvec2{ 1u });
+				glCopyImageSubData(texture.nativeHandle, GL_TEXTURE_2D, static_cast<GLint>(level), 0, 0, 0,
+								   textureArray.nativeHandle, GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), 0, 0,
+								   static_cast<GLint>(layer), static_cast<GLsizei>(mipExtent.x),
+								   static_cast<GLsizei>(mipExtent.y), 1);
+			}
+			// a view created for earlier sprite draws is not needed anymore
+			if (texture.arrayViewNativeHandle != 0)
+			{
+				stateCache.Invalidate();
+				glDeleteTextures(1, &texture.arrayViewNativeHandle);
+				texture.arrayViewNativeHandle = 0;
+			}
+			texture.arrayNativeHandle = textureArray.nativeHandle;
+			texture.arrayLayer = layer;
+		}
+
+		auto handle = Texture2DArrayHandle{};
+		handle.key = GenerateKey();
+		textureArrays[handle] = std::move(textureArray);
+		arrays.push_back(handle);
+	}
+	return arrays;
+}
+
+void RenderContext::DestroyTexture2DArray(const Texture2DArrayHandle textureArray)
+{
+	const auto& textureArrayObject = Get(textureArray);
+	for (const auto layer : textureArrayObject.layers)
+	{
+		// layers may have been destroyed in the meantime, those are simply skipped
+		const auto texture = textures.find(layer);
+		if (texture != textures.end() and texture->second.arrayNativeHandle == textureArrayObject.nativeHandle)
+		{
+			texture->second.arrayNativeHandle = 0;
+			texture->second.arrayLayer = 0;
+		}
+	}
+	stateCache.Invalidate();
+	glDeleteTextures(1, &textureArrayObject.nativeHandle);
+	textureArrays.erase(textureArray);
+}
+
+void RenderContext::ReleaseGroupedTextureStorage(const Texture2DArrayHandle textureArray)
+{
+	const auto& textureArrayObject = Get(textureArray);
+	stateCache.Invalidate();
+	for (const auto layer : textureArrayObject.layers)
+	{
+		const auto texture = textures.find(layer);
+		if (texture != textures.end() and texture->second.arrayNativeHandle == textureArrayObject.nativeHandle)
+		{
+			glDeleteTextures(1, &texture->second.nativeHandle);
+			texture->second.nativeHandle = 0;
+		}
+	}
+}
+
+const Texture2D& RenderContext::GetSpriteTexture(const Texture2DHandle handle)
+{
+	auto& texture = Get(handle);
+	if (texture.arrayNativeHandle == 0)
+	{
+		// released textures only live on in their array
+		assert(texture.nativeHandle != 0);
+		// views need a name that was never bound, so it comes from glGenTextures instead of glCreateTextures
+		glGenTextures(1, &texture.arrayViewNativeHandle);
+		glTextureView(texture.arrayViewNativeHandle, GL_TEXTURE_2D_ARRAY, texture.nativeHandle,
+					  mapToGlFormat(texture.format), 0, texture.levels, 0, 1);
+		glTextureParameteri(texture.arrayViewNativeHandle, GL_TEXTURE_MAX_LEVEL, 0);
+		texture.arrayNativeHandle = texture.arrayViewNativeHandle;
+		texture.arrayLayer = 0;
+	}
+	return texture;
+}
+
+GraphicsPipelineHandle RenderContext::CreateGraphicsPipeline(const GraphicsPipelineDescriptor& descriptor)
+{
+	const auto vertexProgram = CreateShaderProgram(GL_VERTEX_SHADER, descriptor.vertexShaderCode);
+	const auto fragmentProgram = CreateShaderProgram(GL_FRAGMENT_SHADER, descriptor.fragmentShaderCode);
 
 	auto pipeline = GraphicsPipeline{};
 
@@ -326,6 +735,7 @@ GraphicsPipelineHandle RenderContext::CreateGraphicsPipeline(const GraphicsPipel
 
 void RenderContext::DestroyGraphicsPipeline(const GraphicsPipelineHandle graphicsPipeline)
 {
+	stateCache.Invalidate();
 	const auto& pipeline = Get(graphicsPipeline);
 
 	glDeleteProgramPipelines(1, &pipeline.nativeHandle);
@@ -333,6 +743,30 @@ void RenderContext::DestroyGraphicsPipeline(const GraphicsPipelineHandle graphic
 	pipelines.erase(graphicsPipeline);
 }
 
+SamplerHandle RenderContext::CreateSampler(const SamplerDescriptor& descriptor)
+{
+	auto sampler = Sampler{};
+	glCreateSamplers(1, &sampler.nativeHandle);
+	glSamplerParameteri(sampler.nativeHandle, GL_TEXTURE_MIN_FILTER, mapToGlFilter(descriptor.minFilter));
+	glSamplerParameteri(sampler.nativeHandle, GL_TEXTURE_MAG_FILTER, mapToGlFilter(descriptor.magFilter));
+	glSamplerParameteri(sampler.nativeHandle, GL_TEXTURE_WRAP_S, mapToGlAddressMode(descriptor.addressModeU));
+	glSamplerParameteri(sampler.nativeHandle, GL_TEXTURE_WRAP_T, mapToGlAddressMode(descriptor.addressModeV));
+	glObjectLabel(GL_SAMPLER, sampler.nativeHandle, glLabel(descriptor.debugName));
+
+	auto samplerHandle = SamplerHandle{};
+	samplerHandle.key = GenerateKey();
+	samplers[samplerHandle] = sampler;
+	return samplerHandle;
+}
+
+void RenderContext::DestroySampler(const SamplerHandle sampler)
+{
+	stateCache.Invalidate();
+	const auto& samplerObject = Get(sampler);
+	glDeleteSamplers(1, &samplerObject.nativeHandle);
+	samplers.erase(sampler);
+}
+
 Framebuffer& RenderContext::Get(FramebufferHandle handle)
 {
 	return windowSizeDependentFramebuffers[handle].framebuffer;
@@ -343,7 +777,17 @@ Texture2D& RenderContext::Get(Texture2DHandle handle)
 	return textures[handle];
 }
 
+Texture2DArray& RenderContext::Get(Texture2DArrayHandle handle)
+{
+	return textureArrays[handle];
+}
+
 GraphicsPipeline& RenderContext::Get(GraphicsPipelineHandle handle)
 {
 	return pipelines[handle];
 }
+
+Sampler& RenderContext::Get(SamplerHandle handle)
+{
+	return samplers[handle];
+}
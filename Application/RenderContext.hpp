@@ -1,14 +1,22 @@
 #pragma once
 #include <array>
+#include <assert.h>
 #include <optional>
+#include <span>
 #include <unordered_map>
 #include <variant>
 #include <vector>
 
 #include "Color.hpp"
 #include "Common.hpp"
+#include "FrameStats.hpp"
+#include "OpenGlStateCache.hpp"
 #include "RenderResources.hpp"
 
+#ifdef TRACY_ENABLE
+#include <tracy/TracyOpenGL.hpp>
+#endif
+
 struct RenderContext
 {
 	void UpdateWindowSize(const u32 width, const u32 height);
@@ -24,12 +32,37 @@ struct RenderContext
 
 	void UploadTextureData(const Texture2DHandle texture, const u8 level, void* data, size_t size);
 
+	/*
+		Copies textures of the same format, extent and level count into shared GL_TEXTURE_2D_ARRAY objects, one per
+		group, so they can be sampled through a single binding. The texture data has to be uploaded beforehand.
+		Textures without a partner keep sampling from their own single layer view. Larger groups are split into arrays
+		of maxLayers, the minimum GL_MAX_ARRAY_TEXTURE_LAYERS of OpenGL 4.6 by default. Sprite batches drawing packed
+		vertices need arrays of at most SpriteBatch::maxPackedTextureLayers.
+		The grouped textures keep their own storage until ReleaseGroupedTextureStorage(), afterwards their handles
+		still describe the texture and draw sprites from the array, but they can neither be uploaded to nor be
+		sampled again once the array is destroyed.
+	*/
+	static constexpr u32 maxTextureArrayLayers = 2048;
+	std::vector<Texture2DArrayHandle> GroupIntoTextureArrays(std::span<const Texture2DHandle> textures,
+															 const char* debugName = "",
+															 const u32 maxLayers = maxTextureArrayLayers);
+	void ReleaseGroupedTextureStorage(const Texture2DArrayHandle textureArray);
+	void DestroyTexture2DArray(const Texture2DArrayHandle textureArray);
+	// like Get(), but the texture has an array binding to be drawn as a sprite from: its group array or a single layer
+	// view that is created on the first call
+	const Texture2D& GetSpriteTexture(const Texture2DHandle texture);
+
 	GraphicsPipelineHandle CreateGraphicsPipeline(const GraphicsPipelineDescriptor& descriptor);
 	void DestroyGraphicsPipeline(const GraphicsPipelineHandle graphicsPipeline);
 
+	SamplerHandle CreateSampler(const SamplerDescriptor& descriptor);
+	void DestroySampler(const SamplerHandle sampler);
+
 	Framebuffer& Get(FramebufferHandle handle);
 	Texture2D& Get(Texture2DHandle handle);
+	Texture2DArray& Get(Texture2DArrayHandle handle);
 	GraphicsPipeline& Get(GraphicsPipelineHandle handle);
+	Sampler& Get(SamplerHandle handle);
 
 	WindowContext GetWindowsContext() const
 	{
@@ -44,8 +77,80 @@ struct RenderContext
 		return defaultFramebuffer;
 	}
 
+	/*
+		Fill rate debugging: SpriteBatch in SpriteDebugView::overdraw renders into the overdraw framebuffer and adds
+		one per shaded fragment to its r32f count target instead of drawing colors. BeginOverdrawCapture() clears the
+		counts and the depth and starts a GL_SAMPLES_PASSED query around the captured draws. BlitOverdrawHeatmap()
+		shows the counts in place of Blit(), GetAverageOverdraw() returns the shaded fragments per pixel of the last
+		finished query. The query result is read without waiting, so the average lags the heatmap by a few frames.
+		The overdraw framebuffer is created by the first BeginOverdrawCapture() or GetOverdrawFramebuffer() call and
+		follows the window size from then on.
+	*/
+	void BeginOverdrawCapture();
+	void EndOverdrawCapture();
+	void BlitOverdrawHeatmap();
+	f32 GetAverageOverdraw();
+	FramebufferHandle GetOverdrawFramebuffer();
+
+	// all bindings and state changes of the renderer go through the cache
+	OpenGlStateCache& GetStateCache()
+	{
+		return stateCache;
+	}
+
+	/*
+		Frame statistics: BeginFrame() has to be called once at the start of every frame, it moves the counters of
+		the finished frame into the history of the last frameStatsHistorySize frames and resets them. The current
+		frame collects into GetFrameStats(), GetPastFrameStats(0) is the last finished frame.
+		BeginGpuPass()/EndGpuPass() measure the gpu time of the commands between them with a GL_TIME_ELAPSED query
+		taken from a pool of gpuQueryPoolSize. Passes do not nest, an inner pair is ignored. BeginFrame() reads back
+		the queries that are at least gpuQueryLatency frames old and finished, without waiting, and adds their time
+		to the pass of the frame that issued them in the history; with the pool exhausted a pass is not measured.
+		With ENABLE_TRACY every pass is also a zone of the Tracy gpu context.
+	*/
+	static constexpr u32 frameStatsHistorySize = 120;
+	void BeginFrame();
+	FrameStats& GetFrameStats()
+	{
+		return frameStats;
+	}
+	const FrameStats& GetPastFrameStats(const u32 framesAgo) const
+	{
+		assert(framesAgo < frameStatsHistorySize);
+		return frameStatsHistory[(frameStatsHistoryHead + frameStatsHistorySize - 1 - framesAgo) %
+								 frameStatsHistorySize];
+	}
+	u64 GetFrameIndex() const
+	{
+		return frameIndex;
+	}
+	static constexpr u32 gpuQueryPoolSize = 64;
+	static constexpr u32 gpuQueryLatency = 3;
+	void BeginGpuPass(const char* name);
+	void EndGpuPass();
+
+	// gpu pass for the lifetime of the scope, name has to outlive the RenderContext
+	struct GpuPassScope
+	{
+		GpuPassScope(RenderContext& context, const char* name) : context(context)
+		{
+			context.BeginGpuPass(name);
+		}
+		~GpuPassScope()
+		{
+			context.EndGpuPass();
+		}
+		GpuPassScope(const GpuPassScope&) = delete;
+		GpuPassScope& operator=(const GpuPassScope&) = delete;
+
+	private:
+		RenderContext& context;
+	};
+
 private:
 	void RecreateWindowSizeDependentResources();
+	void ResolveOverdrawQuery();
+	void ResolveGpuPassQueries();
 
 	Framebuffer CreateOpenGlFramebuffer(const FramebufferDescriptor& descriptor);
 	void DestroyOpenGlFramebuffer(const Framebuffer& framebuffer);
@@ -56,9 +161,45 @@ private:
 	std::unordered_map<FramebufferHandle, Framebuffer> framebuffers;
 	std::unordered_map<FramebufferHandle, WindowSizeDependentFramebuffer> windowSizeDependentFramebuffers;
 	std::unordered_map<Texture2DHandle, Texture2D> textures;
+	std::unordered_map<Texture2DArrayHandle, Texture2DArray> textureArrays;
 	std::unordered_map<GraphicsPipelineHandle, GraphicsPipeline> pipelines;
+	std::unordered_map<SamplerHandle, Sampler> samplers;
 
 
+	OpenGlStateCache stateCache;
+
 	GraphicsPipelineHandle fullscreenQuadPipeline;
 	FramebufferHandle defaultFramebuffer;
+
+	GraphicsPipelineHandle overdrawHeatmapPipeline;
+	std::optional<FramebufferHandle> overdrawFramebuffer;
+	GLuint overdrawQuery{ 0 };
+	u64 overdrawQueryPixelCount{ 0 };
+	f32 averageOverdraw{ 0.0f };
+	bool isCapturingOverdraw{ false };
+	bool isOverdrawQueryActive{ false };
+	bool isOverdrawQueryPending{ false };
+
+	FrameStats frameStats{};
+	std::array<FrameStats, frameStatsHistorySize> frameStatsHistory{};
+	u32 frameStatsHistoryHead{ 0 };
+	u64 frameIndex{ 0 };
+
+	// the index into gpuPassNames is the index into FrameStats::gpuPasses
+	std::vector<const char*> gpuPassNames;
+	struct GpuQuery
+	{
+		GLuint query;
+		u32 pass;
+		u64 frame;
+	};
+	// ring of queries in issue order, they finish in that order too
+	std::array<GpuQuery, gpuQueryPoolSize> gpuQueries{};
+	u32 gpuQueryHead{ 0 };
+	u32 gpuQueryTail{ 0 };
+	bool isGpuQueryActive{ false };
+	u32 gpuPassDepth{ 0 };
+#ifdef TRACY_ENABLE
+	std::optional<tracy::GpuCtxScope> tracyGpuZone;
+#endif
 };
\ No newline at end of file
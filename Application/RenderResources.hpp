@@ -5,6 +5,7 @@
 #include <array>
 #include <string>
 #include <variant>
+#include <vector>
 
 struct RenderContext;
 
@@ -30,17 +31,22 @@ struct std::hash<Handle<T>>
 };
 
 struct Texture2D;
+struct Texture2DArray;
 struct Framebuffer;
 struct GraphicsPipeline;
+struct Sampler;
 
 using Texture2DHandle = Handle<Texture2D>;
+using Texture2DArrayHandle = Handle<Texture2DArray>;
 using FramebufferHandle = Handle<Framebuffer>;
 using GraphicsPipelineHandle = Handle<GraphicsPipeline>;
+using SamplerHandle = Handle<Sampler>;
 
 enum class TextureFormat
 {
 	unknown,
 	rgba8,
+	r32f,
 	d32f,
 	bc_rgba_unorm
 };
@@ -74,6 +80,22 @@ struct Texture2D
 	u32 height;
 	TextureFormat format;
 	u8 levels;
+	// single layer GL_TEXTURE_2D_ARRAY view of the texture itself, 0 until RenderContext::GetSpriteTexture() needs it
+	GLuint arrayViewNativeHandle;
+	// GL_TEXTURE_2D_ARRAY to sample the texture from, either the own view or a shared array it was copied into; 0 while
+	// neither exists
+	GLuint arrayNativeHandle;
+	u32 arrayLayer;
+};
+
+struct Texture2DArray
+{
+	GLuint nativeHandle;
+	u32 width;
+	u32 height;
+	TextureFormat format;
+	u8 levels;
+	std::vector<Texture2DHandle> layers;
 };
 
 struct Framebuffer
@@ -102,6 +124,8 @@ struct ShaderCode
 {
 	std::string code;
 	const char* debugName = "";
+	// #define lines inserted after the #version line of code
+	std::string defines{};
 };
 
 struct GraphicsPipelineDescriptor
@@ -116,6 +140,34 @@ struct GraphicsPipeline
 	GLuint nativeHandle;
 };
 
+enum class SamplerFilter
+{
+	nearest,
+	linear
+};
+
+enum class SamplerAddressMode
+{
+	repeat,
+	mirroredRepeat,
+	clampToEdge
+};
+
+// the defaults match the sampling state of a texture without a sampler, except that it has no mip levels
+struct SamplerDescriptor
+{
+	SamplerFilter minFilter{ SamplerFilter::linear };
+	SamplerFilter magFilter{ SamplerFilter::linear };
+	SamplerAddressMode addressModeU{ SamplerAddressMode::repeat };
+	SamplerAddressMode addressModeV{ SamplerAddressMode::repeat };
+	const char* debugName = "";
+};
+
+struct Sampler
+{
+	GLuint nativeHandle;
+};
+
 
 struct WindowContext
 {
@@ -1,5 +1,6 @@
 #include "SampleGame.hpp"
 #include <box2d/box2d.h>
+#include <algorithm>
 #include <regex>
 
 #include "ContentManager.hpp"
@@ -165,6 +166,7 @@ struct TileSet
 {
 	u32 firstGlobalId;
 	Texture2DHandle image;
+	std::vector<SpriteRegion> tiles;
 };
 
 std::vector<TileSet> tileSets{};
@@ -533,9 +535,93 @@ void SampleGame::OnLoad()
 	{
 		const auto firstGlobalId = static_cast<u32>(tileSet.firstgid);
 		const auto image = content->LoadTexture(tileSet.image);
-		tileSets.push_back(TileSet{ firstGlobalId, image });
+		tileSets.push_back(TileSet{ firstGlobalId, image, {} });
 	}
 
+	// same sized tile sets and sprite sheets end up in shared texture arrays, so the sprite batch can draw them
+	// together
+	auto spriteTextures = std::vector<Texture2DHandle>{ huskTexture };
+	for (const auto& tileSet : tileSets)
+	{
+		spriteTextures.push_back(tileSet.image);
+	}
+	// the debug ui can switch the batch to packed vertices
+	spriteTextureArrays = renderContext->GroupIntoTextureArrays(spriteTextures, "sprite_texture_array",
+																SpriteBatch::maxPackedTextureLayers);
+	// the textures are only drawn as sprites, their copies in the arrays are all that is needed
+	for (const auto textureArray : spriteTextureArrays)
+	{
+		renderContext->ReleaseGroupedTextureStorage(textureArray);
+	}
+
+	// regions capture the array bindings, so they are created once the arrays exist
+	for (const auto& frame : animationFrames)
+	{
+		huskFrameRegions.push_back(CreateSpriteRegion(*renderContext, huskTexture, frame));
+	}
+	for (auto& tileSet : tileSets)
+	{
+		const auto& image = renderContext->Get(tileSet.image);
+		const auto tileCount = (image.width / 32) * (image.height / 32);
+		for (auto localTileId = u32{ 0 }; localTileId < tileCount; localTileId++)
+		{
+			tileSet.tiles.push_back(CreateTileRegion(*renderContext, tileSet.image, localTileId, vec2{ 32, 32 }));
+		}
+	}
+
+	// the tile layers never change, they are recorded once and redrawn with the camera transform of each frame;
+	// they are alpha tested and depth sorted, the first map layer is the farthest and the character stays in front
+	const auto tileLayerCount = std::count_if(map.layers.begin(), map.layers.end(), [](const auto& layer)
+											  { return layer.type == TiledLayerType::tilelayer; });
+	spriteBatch->SetDepthTesting(true);
+	spriteBatch->BeginRecording();
+	spriteBatch->SetBlendMode(SpriteBlendMode::cutout);
+	auto tileLayerIndex = 0;
+	for (const auto& layer : map.layers)
+	{
+		if (layer.type == TiledLayerType::tilelayer)
+		{
+			const auto depthLayer = 1.0f - static_cast<float>(tileLayerIndex) / static_cast<float>(tileLayerCount);
+			tileLayerIndex++;
+			for (const auto& chunk : layer.chunks)
+			{
+
+				const auto& data = std::get<TiledLayerData>(chunk.data);
+				const auto width = chunk.width;
+				const auto height = chunk.height;
+
+
+				auto index = 0;
+				for (auto x = 0; x < width; x++)
+				{
+					for (auto y = 0; y < height; y++)
+					{
+						const auto dirtyGlobalId = data[index];
+						index++;
+						const auto globalId = static_cast<u32>(dirtyGlobalId & 0xfffffff);
+
+						for (const auto& tileSet : tileSets)
+						{
+
+							if (tileSet.firstGlobalId <= globalId and
+								globalId < (tileSet.firstGlobalId + tileSet.tiles.size()))
+							{
+								const auto localTileId = globalId - tileSet.firstGlobalId;
+								const auto position = vec2{ y * 32 + chunk.x * 32, x * 32 + chunk.y * 32 } +
+									vec2{ layer.offsetx, layer.offsety };
+
+								spriteBatch->Draw(tileSet.tiles[localTileId], Rectangle{ position, { 32, 32 } },
+												  Colors::White, FlipSprite::none, vec2{ 0.0f, 0.0f }, 0.0f,
+												  depthLayer);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+	tileMapCache = spriteBatch->EndRecording();
+
 	for (auto i = 0; i < animations.size(); i++)
 	{
 		animationGraph->AddNode(animations[i].name, i);
@@ -624,6 +710,12 @@ void SampleGame::OnLoad()
 
 void SampleGame::OnUnload()
 {
+	tileMapCache.reset();
+	for (const auto textureArray : spriteTextureArrays)
+	{
+		renderContext->DestroyTexture2DArray(textureArray);
+	}
+	huskFrameRegions.clear();
 	renderContext->DestroyTexture2D(huskTexture);
 }
 
@@ -891,6 +983,50 @@ void SampleGame::OnDraw([[maybe_unused]] const f32 deltaTime)
 
 	physicsWorld->DrawSettingsUI();
 
+	ImGui::Begin("Sprite Batch");
+	auto useVertexPulling = spriteBatch->GetSubmissionMode() == SpriteSubmissionMode::vertexPulling;
+	if (ImGui::Checkbox("Vertex Pulling", &useVertexPulling))
+	{
+		spriteBatch->SetSubmissionMode(useVertexPulling ? SpriteSubmissionMode::vertexPulling :
+														  SpriteSubmissionMode::cpuExpansion);
+	}
+	auto usePackedVertices = spriteBatch->GetVertexFormat() == SpriteVertexFormat::packed;
+	if (ImGui::Checkbox("Packed Vertices", &usePackedVertices))
+	{
+		spriteBatch->SetVertexFormat(usePackedVertices ? SpriteVertexFormat::packed : SpriteVertexFormat::float32);
+	}
+	auto usePremultipliedAlpha = spriteBatch->IsPremultipliedAlpha();
+	if (ImGui::Checkbox("Premultiplied Alpha", &usePremultipliedAlpha))
+	{
+		spriteBatch->SetPremultipliedAlpha(usePremultipliedAlpha);
+	}
+	auto useDepthTesting = spriteBatch->IsDepthTesting();
+	if (ImGui::Checkbox("Depth Testing", &useDepthTesting))
+	{
+		spriteBatch->SetDepthTesting(useDepthTesting);
+	}
+	auto useCulling = spriteBatch->IsCullingEnabled();
+	if (ImGui::Checkbox("Culling", &useCulling))
+	{
+		spriteBatch->SetCulling(useCulling);
+	}
+	auto debugView = static_cast<int>(spriteBatch->GetDebugView());
+	if (ImGui::Combo("Debug View", &debugView, "None\0Overdraw\0Batches\0"))
+	{
+		spriteBatch->SetDebugView(static_cast<SpriteDebugView>(debugView));
+	}
+	if (spriteBatch->GetDebugView() == SpriteDebugView::overdraw)
+	{
+		ImGui::Text("Average overdraw: %.2f", renderContext->GetAverageOverdraw());
+	}
+	ImGui::Text("Culled sprites: %u", spriteBatch->GetCulledSpriteCount());
+	ImGui::Text("Sprite high water mark: %u", spriteBatch->GetSpriteHighWaterMark());
+	const auto stateStatistics = renderContext->GetStateCache().GetStatistics();
+	ImGui::Text("GL state calls issued: %llu, dropped: %llu",
+				static_cast<unsigned long long>(stateStatistics.issuedCalls),
+				static_cast<unsigned long long>(stateStatistics.redundantCalls));
+	ImGui::End();
+
 	const auto& animation = animations[characterAnimationInstance.currentNodeIndex];
 	const auto sequenceIndex = animation.animationIndex + characterAnimationInstance.key;
 	const auto& animationKey = animationSequences[sequenceIndex];
@@ -903,61 +1039,25 @@ void SampleGame::OnDraw([[maybe_unused]] const f32 deltaTime)
 
 	renderContext->Clear(Colors::CornflowerBlue, nonDefaultFramebuffer);
 
+	const auto isCapturingOverdraw = spriteBatch->GetDebugView() == SpriteDebugView::overdraw;
+	if (isCapturingOverdraw)
+	{
+		renderContext->BeginOverdrawCapture();
+	}
 	spriteBatch->Begin(cameraMatrix, defaultEffect.get());
+	spriteBatch->Draw(*tileMapCache);
 	const auto origin = frame.sourceSprite.position + vec2{ frame.sourceSprite.extent.x / 2.0f, 0.0f };
 	const auto extent = vec2{ characterHeight * frameAspectRation, characterHeight };
-	spriteBatch->Draw(huskTexture, frame.sourceSprite, Rectangle{ CastTo<vec2>(transform.p) - extent / 2.0f, extent },
-					  Colors::White,
+	spriteBatch->Draw(huskFrameRegions[animationKey.frameIndex],
+					  Rectangle{ CastTo<vec2>(transform.p) - extent / 2.0f, extent }, Colors::White,
 					  animationKey.flip == FrameFlip::horizontal ? FlipSprite::horizontal : FlipSprite::none, origin);
 
-	const auto& texture = renderContext->Get(tileSets[0].image);
-	const auto xs = (texture.width / 32);
-	const auto ys = (texture.height / 32);
-
-	for (const auto& layer : map.layers)
+	spriteBatch->End();
+	if (isCapturingOverdraw)
 	{
-		if (layer.type == TiledLayerType::tilelayer)
-		{
-			for (const auto& chunk : layer.chunks)
-			{
-
-				const auto& data = std::get<TiledLayerData>(chunk.data);
-				const auto width = chunk.width;
-				const auto height = chunk.height;
-
-
-				auto index = 0;
-				for (auto x = 0; x < width; x++)
-				{
-					for (auto y = 0; y < height; y++)
-					{
-						const auto dirtyGlobalId = data[index];
-						index++;
-						const auto globalId = static_cast<u32>(dirtyGlobalId & 0xfffffff);
-
-						for (const auto& tileSet : tileSets)
-						{
-
-							if (tileSet.firstGlobalId <= globalId and globalId < (tileSet.firstGlobalId + xs * ys))
-							{
-								const auto localTileId = globalId - tileSet.firstGlobalId;
-								const auto row = localTileId % xs;
-								const auto col = localTileId / xs;
-								const auto position = vec2{ y * 32 + chunk.x * 32, x * 32 + chunk.y * 32 } +
-									vec2{ layer.offsetx, layer.offsety };
-
-								spriteBatch->Draw(tileSet.image, Rectangle{ { row * 32, col * 32 }, { 32, 32 } },
-												  Rectangle{ position, { 32, 32 } }, Colors::White);
-							}
-						}
-					}
-				}
-			}
-		}
+		renderContext->EndOverdrawCapture();
 	}
 
-	spriteBatch->End();
-
 	physicsWorld->DebugDraw();
 
 	ImGui::Begin("Physics Body");
@@ -968,5 +1068,12 @@ void SampleGame::OnDraw([[maybe_unused]] const f32 deltaTime)
 
 	animationEditor.Draw();
 
-	renderContext->Blit(nonDefaultFramebuffer, 0);
+	if (isCapturingOverdraw)
+	{
+		renderContext->BlitOverdrawHeatmap();
+	}
+	else
+	{
+		renderContext->Blit(nonDefaultFramebuffer, 0);
+	}
 }
\ No newline at end of file
@@ -1,10 +1,13 @@
 #pragma once
 #include "Game.hpp"
 #include "SpriteBatch.hpp"
+#include "SpriteRegion.hpp"
+#include "StaticSpriteCache.hpp"
 #include "Animation.hpp"
 #include "RenderResources.hpp"
 #include "Effect.hpp"
 #include <memory>
+#include <vector>
 
 struct SampleGame : Game
 {
@@ -27,6 +30,9 @@ private:
 	AnimationSequence characterAnimationSequence{};
 
 	Texture2DHandle huskTexture{};
+	std::vector<Texture2DArrayHandle> spriteTextureArrays{};
+	std::vector<SpriteRegion> huskFrameRegions{};
+	std::unique_ptr<StaticSpriteCache> tileMapCache;
 	FramebufferHandle nonDefaultFramebuffer{};
 
 };
\ No newline at end of file
@@ -3,10 +3,20 @@
 #include "ContentManager.hpp"
 #include "Effect.hpp"
 #include "RenderContext.hpp"
+#include "SpriteBatchKernels.hpp"
+#include "SpriteRecorder.hpp"
+#include "SpriteRegion.hpp"
+#include "StaticSpriteCache.hpp"
+#include "WorkerPool.hpp"
 
 #include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <limits>
+#include <numeric>
 #include <sstream>
 
 #include <tracy/Tracy.hpp>
@@ -21,68 +31,279 @@ namespace
 		stream << file.rdbuf();
 		return TextAsset{ stream.str() };
 	}
-} // namespace
 
-SpriteBatch::SpriteBatch(RenderContext* context) : renderContext(context)
-{
-	glCreateBuffers(1, &vertexBuffer);
-	glNamedBufferStorage(vertexBuffer, defaultBufferSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	// maps a float to an unsigned integer with the same ordering
+	u32 OrderedBits(const float value)
+	{
+		auto bits = u32{};
+		std::memcpy(&bits, &value, sizeof(bits));
+		return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+	}
+
+	// blendMode is the resolved blend mode of the sprite
+	u64 MakeSortKey(const SpriteSortMode sortMode, const SpriteBatch::SpriteInfo& sprite,
+					const SpriteBlendMode blendMode, const u32 sequence)
+	{
+		auto primaryKey = u32{ 0 };
+		switch (sortMode)
+		{
+		case SpriteSortMode::deferred:
+		case SpriteSortMode::immediate:
+			break;
+		case SpriteSortMode::texture:
+			// grouped by blend mode first, then descending array names, textures created first are drawn last and all
+			// layers of an array share a key
+			assert(sprite.textureArray < (1u << 28));
+			primaryKey = (static_cast<u32>(blendMode) << 28) | (~static_cast<u32>(sprite.textureArray) & 0x0fffffffu);
+			break;
+		case SpriteSortMode::backToFront:
+			primaryKey = ~OrderedBits(sprite.layer);
+			break;
+		case SpriteSortMode::frontToBack:
+			primaryKey = OrderedBits(sprite.layer);
+			break;
+		case SpriteSortMode::ySort:
+			primaryKey = OrderedBits(sprite.destination.position.y + sprite.destination.extent.y);
+			break;
+		}
+		return (static_cast<u64>(primaryKey) << 32) | sequence;
+	}
+
+	// opaque sprites first, then cutout ones, both front to back, the others back to front; the layer loses its two
+	// lowest bits to the pass
+	u64 MakeDepthSortKey(const SpriteBatch::SpriteInfo& sprite, const SpriteBlendMode blendMode, const u32 sequence)
+	{
+		const auto pass = blendMode == SpriteBlendMode::opaque ? 0u : (blendMode == SpriteBlendMode::cutout ? 1u : 2u);
+		const auto layerKey = pass < 2 ? OrderedBits(sprite.layer) : ~OrderedBits(sprite.layer);
+		const auto primaryKey = (pass << 30) | (layerKey >> 2);
+		return (static_cast<u64>(primaryKey) << 32) | sequence;
+	}
+
+	// see SpriteBatch::drawAlphaTestBit, the texture slot is added by BuildDrawGroups()
+	u32 PackDrawParameters(const bool alphaTest, const u32 batchIndex)
+	{
+		return (alphaTest ? SpriteBatch::drawAlphaTestBit : 0u) | (batchIndex << SpriteBatch::drawBatchIndexShift);
+	}
+
+	// #define name value, one per line, without suffix so #if can test the value
+	void AppendDefine(std::string& defines, const char* name, const u32 value)
+	{
+		defines += "#define ";
+		defines += name;
+		defines += ' ';
+		defines += std::to_string(value);
+		defines += '\n';
+	}
 
-	glCreateVertexArrays(1, &vertexArrayObject);
-	const auto positionAttribute = GLuint{ 0 };
-	const auto textureCoordinateAttribute = GLuint{ 1 };
-	const auto colorAttribute = GLuint{ 2 };
+	u32 PackFlags(const SpriteBatch::SpriteInfo& sprite)
+	{
+		const auto additive = sprite.blendMode == SpriteBlendMode::additive ? SpriteBatch::additiveFlagBit : 0u;
+		return static_cast<u32>(sprite.flip) | additive | (sprite.textureLayer << SpriteBatch::textureLayerShift);
+	}
 
+	// the textures hold straight alpha, with premultipliedAlpha the shader outputs premultiplied colors; only opaque
+	// sprites write depth
+	void BindBlendState(OpenGlStateCache& state, const SpriteBlendMode mode, const bool premultipliedAlpha,
+						const SpriteDebugView debugView)
+	{
+		state.DepthMask(mode == SpriteBlendMode::opaque or mode == SpriteBlendMode::cutout);
+		if (debugView == SpriteDebugView::overdraw)
+		{
+			// fragment counting
+			state.BlendFunc(GL_ONE, GL_ONE);
+			return;
+		}
+		switch (mode)
+		{
+		case SpriteBlendMode::alpha:
+			state.BlendFunc(premultipliedAlpha ? GL_ONE : GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			break;
+		case SpriteBlendMode::additive:
+			// only reached with straight alpha, see SpriteBatch::ResolveBlendMode()
+			state.BlendFunc(GL_SRC_ALPHA, GL_ONE);
+			break;
+		case SpriteBlendMode::multiply:
+			// premultiplied colors fade the product with the coverage, straight ones ignore the alpha
+			state.BlendFunc(GL_DST_COLOR, premultipliedAlpha ? GL_ONE_MINUS_SRC_ALPHA : GL_ZERO);
+			break;
+		case SpriteBlendMode::opaque:
+		case SpriteBlendMode::cutout:
+			state.BlendFunc(GL_ONE, GL_ZERO);
+			break;
+		}
+	}
 
-	glVertexArrayVertexBuffer(vertexArrayObject, 0, vertexBuffer, 0, sizeof(SpriteQuadVertex));
+	// vertex array of the cpu expanded quads in vertexBuffer, the batch moves the vertex buffer binding to every
+	// submission, the caches keep it at the beginning of their buffer
+	GLuint CreateQuadVertexArray(const GLuint vertexBuffer, const GLuint indexBuffer, const SpriteVertexFormat format)
+	{
+		using SpriteQuadVertex = SpriteBatch::SpriteQuadVertex;
+		using PackedSpriteQuadVertex = SpriteBatch::PackedSpriteQuadVertex;
+		const auto positionAttribute = GLuint{ 0 };
+		const auto textureCoordinateAttribute = GLuint{ 1 };
+		const auto colorAttribute = GLuint{ 2 };
+		const auto textureLayerAttribute = GLuint{ 3 };
+
+		auto vertexArray = GLuint{};
+		glCreateVertexArrays(1, &vertexArray);
+		glVertexArrayElementBuffer(vertexArray, indexBuffer);
+		for (const auto attribute :
+			 { positionAttribute, textureCoordinateAttribute, colorAttribute, textureLayerAttribute })
+		{
+			glEnableVertexArrayAttrib(vertexArray, attribute);
+			glVertexArrayAttribBinding(vertexArray, attribute, 0);
+		}
+
+		if (format == SpriteVertexFormat::float32)
+		{
+			glVertexArrayVertexBuffer(vertexArray, 0, vertexBuffer, 0, sizeof(SpriteQuadVertex));
+			glVertexArrayAttribFormat(vertexArray, positionAttribute, 2, GL_FLOAT, GL_FALSE,
+									  offsetof(SpriteQuadVertex, position));
+			glVertexArrayAttribFormat(vertexArray, textureCoordinateAttribute, 2, GL_FLOAT, GL_FALSE,
+									  offsetof(SpriteQuadVertex, uv));
+			glVertexArrayAttribFormat(vertexArray, colorAttribute, 3, GL_FLOAT, GL_FALSE,
+									  offsetof(SpriteQuadVertex, color));
+			glVertexArrayAttribFormat(vertexArray, textureLayerAttribute, 1, GL_FLOAT, GL_FALSE,
+									  offsetof(SpriteQuadVertex, textureLayer));
+		}
+		else
+		{
+			glVertexArrayVertexBuffer(vertexArray, 0, vertexBuffer, 0, sizeof(PackedSpriteQuadVertex));
+			glVertexArrayAttribFormat(vertexArray, positionAttribute, 2, GL_FLOAT, GL_FALSE,
+									  offsetof(PackedSpriteQuadVertex, position));
+			glVertexArrayAttribFormat(vertexArray, textureCoordinateAttribute, 2, GL_UNSIGNED_SHORT, GL_TRUE,
+									  offsetof(PackedSpriteQuadVertex, uv));
+			glVertexArrayAttribFormat(vertexArray, colorAttribute, 3, GL_UNSIGNED_BYTE, GL_TRUE,
+									  offsetof(PackedSpriteQuadVertex, colorAndTextureLayer));
+			// the layer byte is converted to its integer value as float, not normalized
+			glVertexArrayAttribFormat(vertexArray, textureLayerAttribute, 1, GL_UNSIGNED_BYTE, GL_FALSE,
+									  offsetof(PackedSpriteQuadVertex, colorAndTextureLayer) + 3);
+		}
+		return vertexArray;
+	}
+} // namespace
 
+static_assert(offsetof(SpriteBatchConstants, transform) == 16 and offsetof(SpriteBatchConstants, debugView) == 80);
+static_assert(sizeof(SpriteBatchConstants) == 96);
+static_assert(static_cast<u32>(FlipSprite::horizontalAndVertical) < SpriteBatch::additiveFlagBit and
+			  SpriteBatch::additiveFlagBit < 1u << SpriteBatch::textureLayerShift);
+// the float layer attribute holds integers exactly up to 2^24, the packed one is a byte
+static_assert(RenderContext::maxTextureArrayLayers << SpriteBatch::vertexLayerShift <= 1u << 24);
+static_assert(SpriteBatch::maxPackedTextureLayers << SpriteBatch::vertexLayerShift <= 256);
+static_assert(SpriteBatch::vertexAdditiveBit < 1u << SpriteBatch::vertexLayerShift);
+// the shaders mask the slot with textureSlotCount - 1
+static_assert(SpriteBatch::textureSlotCount ==
+			  1u << (SpriteBatch::drawBatchIndexShift - SpriteBatch::drawTextureSlotShift));
+static_assert(SpriteBatch::drawAlphaTestBit < 1u << SpriteBatch::drawTextureSlotShift);
 
-	glEnableVertexArrayAttrib(vertexArrayObject, positionAttribute);
-	glVertexArrayAttribBinding(vertexArrayObject, positionAttribute, 0);
-	glVertexArrayAttribFormat(vertexArrayObject, positionAttribute, 2, GL_FLOAT, GL_FALSE,
-							  offsetof(SpriteQuadVertex, position));
+std::string SpriteBatch::GetShaderDefines()
+{
+	auto defines = std::string{};
+	AppendDefine(defines, "SPRITE_FLIP_HORIZONTAL_BIT", static_cast<u32>(FlipSprite::horizontal));
+	AppendDefine(defines, "SPRITE_FLIP_VERTICAL_BIT", static_cast<u32>(FlipSprite::vertical));
+	AppendDefine(defines, "SPRITE_ADDITIVE_FLAG_BIT", additiveFlagBit);
+	AppendDefine(defines, "SPRITE_TEXTURE_LAYER_SHIFT", textureLayerShift);
+	AppendDefine(defines, "SPRITE_VERTEX_ADDITIVE_BIT", vertexAdditiveBit);
+	AppendDefine(defines, "SPRITE_VERTEX_LAYER_SHIFT", vertexLayerShift);
+	AppendDefine(defines, "SPRITE_TEXTURE_SLOT_COUNT", textureSlotCount);
+	AppendDefine(defines, "SPRITE_DRAW_ALPHA_TEST_BIT", drawAlphaTestBit);
+	AppendDefine(defines, "SPRITE_DRAW_TEXTURE_SLOT_SHIFT", drawTextureSlotShift);
+	AppendDefine(defines, "SPRITE_DRAW_TEXTURE_SLOT_MASK", textureSlotCount - 1);
+	AppendDefine(defines, "SPRITE_DRAW_BATCH_INDEX_SHIFT", drawBatchIndexShift);
+	return defines;
+}
 
-	glEnableVertexArrayAttrib(vertexArrayObject, textureCoordinateAttribute);
-	glVertexArrayAttribBinding(vertexArrayObject, textureCoordinateAttribute, 0);
-	glVertexArrayAttribFormat(vertexArrayObject, textureCoordinateAttribute, 2, GL_FLOAT, GL_FALSE,
-							  offsetof(SpriteQuadVertex, uv));
+SpriteBatch::SpriteBatch(RenderContext* context, const SpriteSubmissionMode mode)
+	: submissionMode(mode), renderContext(context)
+{
+	expandQuads = kernels::SelectExpandQuads(kernels::DetectInstructionSet());
+	expandPackedQuads = &kernels::ExpandPackedQuads;
 
-	glEnableVertexArrayAttrib(vertexArrayObject, colorAttribute);
-	glVertexArrayAttribBinding(vertexArrayObject, colorAttribute, 0);
-	glVertexArrayAttribFormat(vertexArrayObject, colorAttribute, 4, GL_FLOAT, GL_FALSE,
-							  offsetof(SpriteQuadVertex, color));
+	vertexStream = std::make_unique<StreamingBuffer>(defaultBufferSize, streamingSegmentCount,
+													 "sprite_batch_vertex_stream");
+	constantsStream = std::make_unique<StreamingBuffer>(constantsSegmentSize, streamingSegmentCount,
+														"sprite_batch_constants_stream");
+	drawCommandStream = std::make_unique<StreamingBuffer>(drawCommandSegmentSize, streamingSegmentCount,
+														  "sprite_batch_draw_command_stream");
 
+	// the index pattern is the same for every quad, so it is generated once for the maximal sprite count
+	auto quadIndices = std::vector<u32>{};
+	quadIndices.reserve(maxSpriteCount * indicesPerSprite);
+	for (auto sprite = u32{ 0 }; sprite < maxSpriteCount; sprite++)
+	{
+		const auto vertex = sprite * verticesPerSprite;
+		quadIndices.insert(quadIndices.end(),
+						   { vertex + 0, vertex + 1, vertex + 2, vertex + 2, vertex + 1, vertex + 3 });
+	}
+	glCreateBuffers(1, &indexBuffer);
+	glNamedBufferStorage(indexBuffer, quadIndices.size() * sizeof(u32), quadIndices.data(), 0);
 
-	auto UniformBufferOffset = GLint{ 0 };
-	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &UniformBufferOffset);
-	uniformConstantsSize = glm::max(GLint(sizeof(SpriteBatchConstants)), UniformBufferOffset);
+	vertexArrayObject =
+		CreateQuadVertexArray(vertexStream->buffer.nativeHandle, indexBuffer, SpriteVertexFormat::float32);
+	packedVertexArrayObject =
+		CreateQuadVertexArray(vertexStream->buffer.nativeHandle, indexBuffer, SpriteVertexFormat::packed);
 
-	glCreateBuffers(1, &uniformBuffer.nativeHandle);
+	// vertex pulling reads everything from the storage buffer, only the quad indices are needed
+	glCreateVertexArrays(1, &vertexPullingArrayObject);
+	glVertexArrayElementBuffer(vertexPullingArrayObject, indexBuffer);
 
 
-	glNamedBufferStorage(uniformBuffer.nativeHandle, uniformConstantsSize, nullptr,
-						 GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+	auto uniformBufferOffset = GLint{ 0 };
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformBufferOffset);
+	uniformBufferAlignment = static_cast<u32>(glm::max(uniformBufferOffset, GLint{ 1 }));
 
-	uniformBuffer.mappedPtr =
-		static_cast<void*>(glMapNamedBufferRange(uniformBuffer.nativeHandle, 0, uniformConstantsSize,
-												 GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT));
+	auto storageBufferOffset = GLint{ 0 };
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageBufferOffset);
+	storageBufferAlignment = static_cast<u32>(glm::max(storageBufferOffset, GLint{ 1 }));
 
 
+	const auto vertexShaderCode = LoadText("Shaders/DefaultSpriteBatch.vert");
+	const auto fragmentShaderCode = LoadText("Shaders/DefaultSpriteBatch.frag");
 	defaultSpriteBatchPipeline = renderContext->CreateGraphicsPipeline(GraphicsPipelineDescriptor{
-		.vertexShaderCode = { LoadText("Shaders/DefaultSpriteBatch.vert"), "Shaders/DefaultSpriteBatch.vert" },
-		.fragmentShaderCode = { LoadText("Shaders/DefaultSpriteBatch.frag"), "Shaders/DefaultSpriteBatch.frag" },
+		.vertexShaderCode = { vertexShaderCode, "Shaders/DefaultSpriteBatch.vert", GetShaderDefines() },
+		.fragmentShaderCode = { fragmentShaderCode, "Shaders/DefaultSpriteBatch.frag", GetShaderDefines() },
 		.debugName = "DefaultSpriteBatchPipeline" });
+	opaqueSpriteBatchPipeline = renderContext->CreateGraphicsPipeline(GraphicsPipelineDescriptor{
+		.vertexShaderCode = { vertexShaderCode, "Shaders/DefaultSpriteBatch.vert", GetShaderDefines() },
+		.fragmentShaderCode = { fragmentShaderCode, "Shaders/DefaultSpriteBatch.frag",
+								GetShaderDefines() + "#define SPRITE_OPAQUE 1\n" },
+		.debugName = "OpaqueSpriteBatchPipeline" });
+	defaultSampler = renderContext->CreateSampler(SamplerDescriptor{ .minFilter = SamplerFilter::nearest,
+																	  .magFilter = SamplerFilter::nearest,
+																	  .debugName = "DefaultSpriteBatchSampler" });
 }
 
 SpriteBatch::~SpriteBatch()
 {
-	glUnmapNamedBuffer(uniformBuffer.nativeHandle);
+	renderContext->GetStateCache().Invalidate();
+	glDeleteVertexArrays(1, &vertexArrayObject);
+	glDeleteVertexArrays(1, &packedVertexArrayObject);
+	glDeleteVertexArrays(1, &vertexPullingArrayObject);
+	glDeleteBuffers(1, &indexBuffer);
 	renderContext->DestroyGraphicsPipeline(defaultSpriteBatchPipeline);
+	renderContext->DestroyGraphicsPipeline(opaqueSpriteBatchPipeline);
+	renderContext->DestroySampler(defaultSampler);
 }
 
-void SpriteBatch::Begin(const mat3& transform, Effect* effect)
+void SpriteBatch::Begin(const mat3& transform, Effect* effect, const SpriteSortMode sortMode,
+						const std::optional<SamplerHandle> sampler)
 {
 	// ZoneScoped;
+	auto& state = renderContext->GetStateCache();
+	assert(not isRecording);
+	if (frameStatsIndex != renderContext->GetFrameIndex())
+	{
+		frameStats = FrameStats{};
+		frameStatsIndex = renderContext->GetFrameIndex();
+	}
+	passStats = FrameStats{};
+	passFirstStateChanges = state.GetStatistics().issuedCalls;
+	passFirstUploadedBytes = GetUploadedBytes();
+	renderContext->BeginGpuPass("SpriteBatch");
+	this->sortMode = sortMode;
+	blendMode = SpriteBlendMode::alpha;
+	// texture arrays may have been regrouped since the last frame
+	resolvedTexture.reset();
 	auto fbo = FramebufferHandle{};
 	auto pso = GraphicsPipelineHandle{};
 	if (effect)
@@ -95,149 +316,875 @@ void SpriteBatch::Begin(const mat3& transform, Effect* effect)
 		fbo = renderContext->GetDefaultFramebuffer();
 		pso = defaultSpriteBatchPipeline;
 	}
+	usesCustomShaders = effect and not effect->usesDefaultShaders;
+	assert(not usesCustomShaders or
+		   (submissionMode == SpriteSubmissionMode::cpuExpansion and not premultipliedAlpha and not depthTesting and
+			debugView == SpriteDebugView::none));
+	if (debugView == SpriteDebugView::overdraw)
+	{
+		fbo = renderContext->GetOverdrawFramebuffer();
+	}
 	const auto& framebuffer = renderContext->Get(fbo);
 	const auto& framebufferTexture = renderContext->Get(framebuffer.colorAttachment[0]);
-	glViewport(0, 0, framebufferTexture.width, framebufferTexture.height);
-	glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
-	glFrontFace(GL_CCW);
-	glCullFace(GL_BACK);
+	state.Viewport(0, 0, framebufferTexture.width, framebufferTexture.height);
+	state.ClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+	state.FrontFace(GL_CCW);
+	state.CullFace(GL_BACK);
+
+	state.SetEnabled(GL_CULL_FACE, true);
+	state.SetEnabled(GL_DEPTH_TEST, depthTesting);
+	state.DepthFunc(GL_GEQUAL);
 
-	glEnable(GL_CULL_FACE);
+	state.BindFramebuffer(framebuffer.nativeHandle);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.nativeHandle);
+	passPipeline = renderContext->Get(pso).nativeHandle;
+	state.BindProgramPipeline(passPipeline);
+	BindSubmissionState();
+	// one sampler for all texture slots, the per batch texture binds leave the sampling state untouched
+	const auto samplerHandle = renderContext->Get(sampler.value_or(defaultSampler)).nativeHandle;
+	auto slotSamplers = std::array<GLuint, textureSlotCount>{};
+	slotSamplers.fill(samplerHandle);
+	state.BindSamplers(0, textureSlotCount, slotSamplers.data());
+	constants = SpriteBatchConstants{ .viewportSize = vec2{ static_cast<float>(framebufferTexture.width),
+															static_cast<float>(framebufferTexture.height) },
+									  .vertexPulling =
+										  submissionMode == SpriteSubmissionMode::vertexPulling ? 1u : 0u,
+									  .premultipliedAlpha = premultipliedAlpha ? 1u : 0u,
+									  .transform = transform,
+									  .debugView = static_cast<u32>(debugView),
+									  .depthTesting = depthTesting ? 1u : 0u };
+	BindConstants(constants);
 
-	glBindProgramPipeline(renderContext->Get(pso).nativeHandle);
-	glBindVertexArray(vertexArrayObject);
-	// TODO:glBindTextureUnit, glBindSamplers, glBindBufferRange for uniforms
-	const auto uniformConstants =
-		SpriteBatchConstants{ .viewportSize = vec2{ static_cast<float>(framebufferTexture.width),
-													static_cast<float>(framebufferTexture.height) },
-							  .transform = transform };
-	std::memcpy(uniformBuffer.mappedPtr, &uniformConstants, sizeof(SpriteBatchConstants));
-	glBindBufferRange(GL_UNIFORM_BUFFER, 0, uniformBuffer.nativeHandle, 0, uniformConstantsSize);
-	glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	// the shader maps transform * position in [0, viewportSize] onto the framebuffer, so the visible world area is
+	// the bounding box of the inverse transformed viewport corners
+	culledSpriteCount = 0;
+	const auto inverseTransform = glm::inverse(transform);
+	visibleMin = vec2{ std::numeric_limits<float>::max() };
+	visibleMax = vec2{ std::numeric_limits<float>::lowest() };
+	for (const auto corner : { vec2{ 0.0f, 0.0f }, vec2{ constants.viewportSize.x, 0.0f },
+							   vec2{ 0.0f, constants.viewportSize.y }, constants.viewportSize })
+	{
+		const auto world = vec2{ inverseTransform * vec3{ corner, 1.0f } };
+		visibleMin = glm::min(visibleMin, world);
+		visibleMax = glm::max(visibleMax, world);
+	}
+	// the blend function is bound per draw group
+	state.SetEnabled(GL_BLEND, true);
 }
 
 void SpriteBatch::End()
 {
 	// ZoneScoped;
-	const auto hasSomeWork = true;
-	if (hasSomeWork)
+	const auto start = std::chrono::steady_clock::now();
+	auto& state = renderContext->GetStateCache();
+	MergeRecorders();
+	Flush();
+	state.SetEnabled(GL_BLEND, false);
+	state.SetEnabled(GL_DEPTH_TEST, false);
+	state.DepthMask(true);
+	// later users of the texture units, e.g. RenderContext::Blit(), expect the texture sampling state
+	state.BindSamplers(0, textureSlotCount, nullptr);
+	constantsStream->Fence();
+	renderContext->EndGpuPass();
+
+	passStats.spritesCulled = culledSpriteCount;
+	passStats.stateChanges = static_cast<u32>(state.GetStatistics().issuedCalls - passFirstStateChanges);
+	passStats.bytesUploaded = GetUploadedBytes() - passFirstUploadedBytes;
+	passStats.endCpuMilliseconds =
+		std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - start).count();
+	frameStats.Accumulate(passStats);
+	renderContext->GetFrameStats().Accumulate(passStats);
+}
+
+void SpriteBatch::BeginRecording(const SpriteSortMode sortMode)
+{
+	assert(not isRecording and spriteStreams.IsEmpty());
+	assert(sortMode != SpriteSortMode::immediate);
+	isRecording = true;
+	this->sortMode = sortMode;
+	blendMode = SpriteBlendMode::alpha;
+	resolvedTexture.reset();
+}
+
+std::unique_ptr<StaticSpriteCache> SpriteBatch::EndRecording()
+{
+	assert(isRecording);
+	MergeRecorders();
+	isRecording = false;
+	auto cache = std::make_unique<StaticSpriteCache>();
+	cache->stateCache = &renderContext->GetStateCache();
+	cache->submissionMode = submissionMode;
+	cache->vertexFormat = vertexFormat;
+	cache->premultipliedAlpha = premultipliedAlpha;
+	cache->depthTesting = depthTesting;
+	cache->spriteCount = spriteStreams.Size();
+
+	// the sprites are generated into system memory chunk by chunk, exactly as End() would stream them, so no batch
+	// grows beyond the quad index buffer
+	const auto indices = SortSprites();
+	const auto bytesPerSprite = GetBytesPerSprite();
+	auto spriteData = std::vector<std::byte>(indices.size() * bytesPerSprite);
+	auto commands = std::vector<DrawElementsIndirectCommand>{};
+	for (auto first = size_t{ 0 }; first < indices.size(); first += flushChunkSpriteCount)
 	{
-		std::sort(spriteInfos.begin(), spriteInfos.end(),
-				  [](const SpriteBatch::SpriteInfo& a, const SpriteBatch::SpriteInfo& b)
-				  { return a.texture > b.texture; });
+		const auto count = std::min<size_t>(flushChunkSpriteCount, indices.size() - first);
+		const auto chunk = indices.subspan(first, count);
+		BuildBatches(chunk);
+		GenerateSprites(chunk, spriteData.data() + first * bytesPerSprite);
+		BuildDrawGroups();
+		for (auto group : drawGroups)
+		{
+			group.firstCommand += static_cast<u32>(commands.size());
+			cache->drawGroups.push_back(group);
+		}
+		for (const auto& batch : batches)
+		{
+			commands.push_back(MakeDrawCommand(batch, static_cast<u32>(first) * verticesPerSprite));
+		}
+	}
+	cache->batchCount = static_cast<u32>(commands.size());
+	auto layers = std::vector<float>{};
+	if (depthTesting and submissionMode == SpriteSubmissionMode::cpuExpansion)
+	{
+		layers.resize(indices.size());
+		GenerateSpriteLayers(indices, layers.data());
+	}
 
-		auto lastTexture = !spriteInfos.empty() ? spriteInfos.front().texture : Texture2DHandle{};
-		auto vertexOffset = u32{ 0 };
-		auto vertexCount = u32{ 0 };
+	if (not commands.empty())
+	{
+		glCreateBuffers(1, &cache->vertexBuffer);
+		glNamedBufferStorage(cache->vertexBuffer, spriteData.size(), spriteData.data(), 0);
+		glCreateBuffers(1, &cache->drawCommandBuffer);
+		glNamedBufferStorage(cache->drawCommandBuffer, commands.size() * sizeof(DrawElementsIndirectCommand),
+							 commands.data(), 0);
+		if (not layers.empty())
+		{
+			glCreateBuffers(1, &cache->layerBuffer);
+			glNamedBufferStorage(cache->layerBuffer, layers.size() * sizeof(float), layers.data(), 0);
+		}
+		if (submissionMode == SpriteSubmissionMode::cpuExpansion)
+		{
+			cache->vertexArrayObject = CreateQuadVertexArray(cache->vertexBuffer, indexBuffer, vertexFormat);
+		}
+	}
+	spriteStreams.Clear();
+	sortKeys.clear();
+	batches.clear();
+	return cache;
+}
 
+void SpriteBatch::Draw(const StaticSpriteCache& cache)
+{
+	auto& state = renderContext->GetStateCache();
+	assert(not isRecording);
+	assert(not usesCustomShaders or
+		   (cache.submissionMode == SpriteSubmissionMode::cpuExpansion and not cache.premultipliedAlpha and
+			not cache.depthTesting));
+	// sprites drawn before the cache stay below it
+	Flush();
+	if (cache.drawGroups.empty())
+	{
+		return;
+	}
+	passStats.spritesSubmitted += cache.spriteCount;
+	passStats.batches += cache.batchCount;
 
-		for (const auto& spriteInfo : spriteInfos)
+	const auto isVertexPulling = cache.submissionMode == SpriteSubmissionMode::vertexPulling;
+	const auto switchesConstants = isVertexPulling != (submissionMode == SpriteSubmissionMode::vertexPulling) or
+		cache.premultipliedAlpha != premultipliedAlpha or cache.depthTesting != depthTesting;
+	if (switchesConstants)
+	{
+		auto cacheConstants = constants;
+		cacheConstants.vertexPulling = isVertexPulling ? 1u : 0u;
+		cacheConstants.premultipliedAlpha = cache.premultipliedAlpha ? 1u : 0u;
+		cacheConstants.depthTesting = cache.depthTesting ? 1u : 0u;
+		BindConstants(cacheConstants);
+	}
+	if (isVertexPulling)
+	{
+		state.BindVertexArray(vertexPullingArrayObject);
+		state.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, cache.vertexBuffer);
+	}
+	else
+	{
+		state.BindVertexArray(cache.vertexArrayObject);
+		if (cache.layerBuffer != 0)
 		{
-			const auto position = spriteInfo.destination.position;
-			const auto extent = spriteInfo.destination.extent + vec2{ 1.0f, 1.0f }; // TODO: investigate
-			const auto color = vec4{ spriteInfo.color.r / 255.0f, spriteInfo.color.g / 255.0f,
-									 spriteInfo.color.b / 255.0f, spriteInfo.color.a / 255.0f };
+			state.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, cache.layerBuffer);
+		}
+	}
+	state.BindBuffer(GL_DRAW_INDIRECT_BUFFER, cache.drawCommandBuffer);
+	state.SetEnabled(GL_DEPTH_TEST, cache.depthTesting);
+	DrawCommandGroups(cache.drawGroups, 0, cache.premultipliedAlpha);
+	state.SetEnabled(GL_DEPTH_TEST, depthTesting);
 
-			const auto& textureData = renderContext->Get(spriteInfo.texture);
-			const auto textureExtent = vec2{ textureData.width, textureData.height };
+	BindSubmissionState();
+	if (switchesConstants)
+	{
+		BindConstants(constants);
+	}
+}
 
-			const auto srcRect = spriteInfo.source;
-			auto uv0 = (srcRect.position) / textureExtent;
-			auto uv1 = (srcRect.position + srcRect.extent) / textureExtent;
+void SpriteBatch::Add(SpriteRecorder& recorder)
+{
+	recorders.push_back(&recorder);
+}
 
+void SpriteBatch::MergeRecorders()
+{
+	if (recorders.empty())
+	{
+		return;
+	}
 
-			if (spriteInfo.flip == FlipSprite::horizontal or spriteInfo.flip == FlipSprite::horizontalAndVertical)
+	// every recorder is filtered and copied by one job; the destination ranges follow the order of Add(), so the
+	// merged list does not depend on the thread timing
+	const auto recorderCount = static_cast<u32>(recorders.size());
+	const auto culls = cullingEnabled and not isRecording;
+	auto recordedSpriteCount = size_t{ 0 };
+	for (const auto recorder : recorders)
+	{
+		recordedSpriteCount += recorder->sprites.size();
+	}
+	const auto forEachRecorder = [&](const WorkerPool::RangeJob& job)
+	{
+		if (recordedSpriteCount < parallelThreshold)
+		{
+			job(0, recorderCount);
+		}
+		else
+		{
+			GetWorkerPool().ParallelFor(recorderCount, 1, job);
+		}
+	};
+
+	recorderOffsets.resize(recorderCount);
+	forEachRecorder(
+		[&](const u32 first, const u32 last)
+		{
+			for (auto recorder = first; recorder < last; recorder++)
 			{
-				const auto x = uv0.x;
-				uv0.x = uv1.x;
-				uv1.x = x;
+				const auto& sprites = recorders[recorder]->sprites;
+				recorderOffsets[recorder] =
+					culls ? static_cast<u32>(std::count_if(sprites.begin(), sprites.end(),
+														   [&](const SpriteInfo& sprite)
+														   { return not IsOutsideView(sprite); })) :
+							static_cast<u32>(sprites.size());
 			}
-			if (spriteInfo.flip == FlipSprite::vertical or spriteInfo.flip == FlipSprite::horizontalAndVertical)
+		});
+	const auto firstSprite = spriteStreams.Size();
+	const auto mergedSpriteCount = std::reduce(recorderOffsets.begin(), recorderOffsets.end(), u32{ 0 });
+	std::exclusive_scan(recorderOffsets.begin(), recorderOffsets.end(), recorderOffsets.begin(), firstSprite);
+	culledSpriteCount += static_cast<u32>(recordedSpriteCount) - mergedSpriteCount;
+	spriteStreams.Resize(firstSprite + mergedSpriteCount);
+	sortKeys.resize(firstSprite + mergedSpriteCount);
+
+	forEachRecorder(
+		[&](const u32 first, const u32 last)
+		{
+			for (auto recorder = first; recorder < last; recorder++)
 			{
-				const auto y = uv0.y;
-				uv0.y = uv1.y;
-				uv1.y = y;
+				auto sequence = recorderOffsets[recorder];
+				for (const auto& sprite : recorders[recorder]->sprites)
+				{
+					if (culls and IsOutsideView(sprite))
+					{
+						continue;
+					}
+					spriteStreams.Set(sequence, sprite);
+					sortKeys[sequence] = ComputeSortKey(sprite, sequence);
+					sequence++;
+				}
+				recorders[recorder]->Clear();
 			}
+		});
+	recorders.clear();
+}
 
-			generatedVertices.push_back(SpriteQuadVertex{ position + vec2{ extent.x, 0 }, { uv1.x, uv0.y }, color });
-			generatedVertices.push_back(SpriteQuadVertex{ position, uv0, color });
-			generatedVertices.push_back(SpriteQuadVertex{ position + vec2{ extent.x, extent.y }, uv1, color });
+void SpriteBatch::BindSubmissionState()
+{
+	auto& state = renderContext->GetStateCache();
+	if (submissionMode == SpriteSubmissionMode::vertexPulling)
+	{
+		state.BindVertexArray(vertexPullingArrayObject);
+	}
+	else
+	{
+		state.BindVertexArray(vertexFormat == SpriteVertexFormat::packed ? packedVertexArrayObject : vertexArrayObject);
+	}
+	state.BindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandStream->buffer.nativeHandle);
+}
+
+void SpriteBatch::BindConstants(const SpriteBatchConstants& uniformConstants)
+{
+	auto& state = renderContext->GetStateCache();
+	const auto allocation = constantsStream->Allocate(sizeof(SpriteBatchConstants), uniformBufferAlignment);
+	std::memcpy(allocation.data, &uniformConstants, sizeof(SpriteBatchConstants));
+	state.BindBufferRange(GL_UNIFORM_BUFFER, 0, constantsStream->buffer.nativeHandle, allocation.offset,
+					  sizeof(SpriteBatchConstants));
+}
+
+std::span<const u32> SpriteBatch::SortSprites()
+{
+	sortedIndices.resize(spriteStreams.Size());
+	std::iota(sortedIndices.begin(), sortedIndices.end(), u32{ 0 });
+	const auto needsSorting =
+		depthTesting or (sortMode != SpriteSortMode::deferred and sortMode != SpriteSortMode::immediate);
+	if (needsSorting and not spriteStreams.IsEmpty())
+	{
+		// the indices start in submission order, so the sequence number bytes of the keys need no passes
+		sortScratch.resize(spriteStreams.Size());
+		kernels::RadixSortIndices(sortKeys, sortedIndices, sortScratch, 4);
+	}
+	return sortedIndices;
+}
 
-			generatedVertices.push_back(SpriteQuadVertex{ position + vec2{ extent.x, extent.y }, uv1, color });
-			generatedVertices.push_back(SpriteQuadVertex{ position, uv0, color });
-			generatedVertices.push_back(SpriteQuadVertex{ position + vec2{ 0, extent.y }, { uv0.x, uv1.y }, color });
+void SpriteBatch::Flush()
+{
+	const auto hasSomeWork = not spriteStreams.IsEmpty();
+	if (hasSomeWork)
+	{
+		const auto indices = SortSprites();
+		spriteHighWaterMark = std::max(spriteHighWaterMark, spriteStreams.Size());
+		passStats.spritesSubmitted += spriteStreams.Size();
 
-			if (lastTexture != spriteInfo.texture)
+		// sprites beyond one chunk are submitted chunk by chunk in sorted order; the draws of a chunk are flushed to
+		// the driver right away, so the gpu consumes chunk n while the cpu generates chunk n + 1 into the next part
+		// of the ring
+		for (auto first = size_t{ 0 }; first < indices.size(); first += flushChunkSpriteCount)
+		{
+			const auto count = std::min<size_t>(flushChunkSpriteCount, indices.size() - first);
+			SubmitSprites(indices.subspan(first, count));
+			if (first + count < indices.size())
 			{
-				batches.push_back(Batch{ lastTexture, vertexOffset, vertexCount });
-				lastTexture = spriteInfo.texture;
-				vertexOffset += vertexCount;
-				vertexCount = 0;
+				glFlush();
 			}
-			vertexCount += 6;
 		}
+	}
+	spriteStreams.Clear();
+	sortKeys.clear();
+	batches.clear();
+}
 
-		batches.push_back(Batch{ lastTexture, vertexOffset, vertexCount });
+u32 SpriteBatch::GetBytesPerSprite() const
+{
+	if (submissionMode == SpriteSubmissionMode::vertexPulling)
+	{
+		return sizeof(SpriteRecord);
+	}
+	const auto vertexSize =
+		vertexFormat == SpriteVertexFormat::packed ? sizeof(PackedSpriteQuadVertex) : sizeof(SpriteQuadVertex);
+	return static_cast<u32>(verticesPerSprite * vertexSize);
+}
 
-		glNamedBufferSubData(vertexBuffer, 0, generatedVertices.size() * sizeof(SpriteQuadVertex),
-							 generatedVertices.data());
+u64 SpriteBatch::GetUploadedBytes() const
+{
+	return vertexStream->GetAllocatedBytes() + constantsStream->GetAllocatedBytes() +
+		drawCommandStream->GetAllocatedBytes();
+}
 
-		glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+void SpriteBatch::SubmitSprites(std::span<const u32> indices)
+{
+	auto& state = renderContext->GetStateCache();
+	assert(indices.size() <= flushChunkSpriteCount);
+	const auto isVertexPulling = submissionMode == SpriteSubmissionMode::vertexPulling;
+	const auto spriteCount = static_cast<u32>(indices.size());
+	const auto bytesPerSprite = GetBytesPerSprite();
+	const auto vertexSize = bytesPerSprite / verticesPerSprite;
 
+	// sprites are generated straight into the mapped ring, no intermediate copy is needed; with depth testing the
+	// layers of the expanded quads follow the vertices in the same allocation, a second one could wrap the ring
+	// before the draws reading the vertices are issued
+	const auto hasLayers = depthTesting and not isVertexPulling;
+	const auto vertexBytes = spriteCount * bytesPerSprite;
+	const auto layerOffset =
+		(vertexBytes + storageBufferAlignment - 1) / storageBufferAlignment * storageBufferAlignment;
+	const auto layerBytes = spriteCount * static_cast<u32>(sizeof(float));
+	const auto vertexAlignment = hasLayers ? std::lcm(vertexSize, storageBufferAlignment) : vertexSize;
+	const auto alignment = isVertexPulling ? storageBufferAlignment : vertexAlignment;
+	const auto allocation = vertexStream->Allocate(hasLayers ? layerOffset + layerBytes : vertexBytes, alignment);
+	BuildBatches(indices);
+	GenerateSprites(indices, allocation.data);
+	BuildDrawGroups();
+	passStats.batches += static_cast<u32>(batches.size());
 
-		for (const auto& batch : batches)
+	// the storage buffer range or the vertex buffer binding starts at the allocation, so gl_VertexID / 4 indexes the
+	// sprites of this submission
+	if (isVertexPulling)
+	{
+		state.BindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, vertexStream->buffer.nativeHandle, allocation.offset,
+						  spriteCount * bytesPerSprite);
+	}
+	else
+	{
+		const auto vertexArray =
+			vertexFormat == SpriteVertexFormat::packed ? packedVertexArrayObject : vertexArrayObject;
+		glVertexArrayVertexBuffer(vertexArray, 0, vertexStream->buffer.nativeHandle, allocation.offset,
+								  static_cast<GLsizei>(vertexSize));
+		if (hasLayers)
 		{
-			const auto& texture = renderContext->Get(batch.texture);
-			glBindTextureUnit(0, texture.nativeHandle);
+			GenerateSpriteLayers(indices, reinterpret_cast<float*>(static_cast<u8*>(allocation.data) + layerOffset));
+			state.BindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, vertexStream->buffer.nativeHandle,
+								  allocation.offset + layerOffset, layerBytes);
+		}
+	}
+
+	const auto commandAllocation = drawCommandStream->Allocate(
+		static_cast<u32>(batches.size() * sizeof(DrawElementsIndirectCommand)), alignof(DrawElementsIndirectCommand));
+	const auto commands =
+		std::span{ static_cast<DrawElementsIndirectCommand*>(commandAllocation.data), batches.size() };
+	for (auto i = size_t{ 0 }; i < batches.size(); i++)
+	{
+		commands[i] = MakeDrawCommand(batches[i], 0);
+	}
+	DrawCommandGroups(drawGroups, commandAllocation.offset, premultipliedAlpha);
+	drawCommandStream->Fence();
+	vertexStream->Fence();
+}
 
-			// TODO: we need a proper way to set up a texture sampler
-			glTextureParameteri(texture.nativeHandle, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTextureParameteri(texture.nativeHandle, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			/*glTextureParameteri(texture.nativeHandle, GL_TEXTURE_MAX_LEVEL, 0);
-			glTextureParameteri(texture.nativeHandle, GL_TEXTURE_MIN_LOD, 0);
-			glTextureParameteri(texture.nativeHandle, GL_TEXTURE_MAX_LOD, 0);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);*/
-			glDrawArraysInstancedBaseInstance(GL_TRIANGLES, batch.vertexOffset, batch.vertexCount, 1, 0);
+void SpriteBatch::BuildBatches(std::span<const u32> indices)
+{
+	// the chunk size below would be 0 for no sprites
+	assert(not indices.empty());
+	const auto spriteCount = static_cast<u32>(indices.size());
+	const auto startsBatch = [&](const u32 position)
+	{
+		if (position == 0)
+		{
+			return true;
 		}
+		const auto sprite = indices[position];
+		const auto previous = indices[position - 1];
+		const auto& streams = spriteStreams;
+		return streams.textureArrays[sprite] != streams.textureArrays[previous] or
+			ResolveBlendMode(streams.blendModes[sprite]) != ResolveBlendMode(streams.blendModes[previous]);
+	};
+
+	// batch boundaries are a parallel scan: count the runs starting in each chunk, prefix sum the counts and let
+	// every chunk write its batches at its offset
+	const auto chunkCount = (spriteCount + parallelChunkSize - 1) / parallelChunkSize;
+	const auto chunkSize = spriteCount < parallelThreshold ? spriteCount : parallelChunkSize;
+	chunkBatchCounts.assign(spriteCount < parallelThreshold ? 1 : chunkCount, 0);
+	ParallelFor(spriteCount,
+				[&](const u32 first, const u32 last)
+				{
+					auto count = u32{ 0 };
+					for (auto position = first; position < last; position++)
+					{
+						count += startsBatch(position) ? 1 : 0;
+					}
+					chunkBatchCounts[first / chunkSize] = count;
+				});
+	const auto batchCount = std::reduce(chunkBatchCounts.begin(), chunkBatchCounts.end(), u32{ 0 });
+	std::exclusive_scan(chunkBatchCounts.begin(), chunkBatchCounts.end(), chunkBatchCounts.begin(), u32{ 0 });
+	batches.resize(batchCount);
+	ParallelFor(spriteCount,
+				[&](const u32 first, const u32 last)
+				{
+					auto batch = chunkBatchCounts[first / chunkSize];
+					for (auto position = first; position < last; position++)
+					{
+						if (startsBatch(position))
+						{
+							const auto sprite = indices[position];
+							const auto blendMode = ResolveBlendMode(spriteStreams.blendModes[sprite]);
+							const auto alphaTest = blendMode == SpriteBlendMode::cutout;
+							const auto drawParameters = PackDrawParameters(alphaTest, batch);
+							batches[batch++] =
+								Batch{ spriteStreams.textureArrays[sprite], position, 0, blendMode, drawParameters };
+						}
+					}
+				});
+
+	for (auto i = size_t{ 0 }; i < batches.size(); i++)
+	{
+		auto& batch = batches[i];
+		const auto nextFirstSprite = i + 1 < batches.size() ? batches[i + 1].firstSprite : spriteCount;
+		batch.spriteCount = nextFirstSprite - batch.firstSprite;
 	}
-	glDisable(GL_BLEND);
-	spriteInfos.clear();
-	generatedVertices.clear();
-	batches.clear();
+}
+
+void SpriteBatch::GenerateSprites(std::span<const u32> indices, void* destination)
+{
+	const auto isVertexPulling = submissionMode == SpriteSubmissionMode::vertexPulling;
+	const auto isPacked = not isVertexPulling and vertexFormat == SpriteVertexFormat::packed;
+	const auto isFloat32 = not isVertexPulling and not isPacked;
+	const auto spriteCount = static_cast<u32>(indices.size());
+	const auto vertices =
+		std::span{ static_cast<SpriteQuadVertex*>(destination), isFloat32 ? spriteCount * verticesPerSprite : 0 };
+	const auto packedVertices = std::span{ static_cast<PackedSpriteQuadVertex*>(destination),
+										   isPacked ? spriteCount * verticesPerSprite : 0 };
+	const auto records = std::span{ static_cast<SpriteRecord*>(destination), isVertexPulling ? spriteCount : 0 };
+
+	// each chunk writes a disjoint slice of the destination, split further at the batches it overlaps
+	ParallelFor(spriteCount,
+				[&](const u32 first, const u32 last)
+				{
+					auto batch = std::upper_bound(batches.begin(), batches.end(), first,
+												  [](const u32 position, const Batch& candidate)
+												  { return position < candidate.firstSprite; }) -
+						1;
+					for (auto position = first; position < last; batch++)
+					{
+						const auto end = std::min(last, batch->firstSprite + batch->spriteCount);
+						const auto run = indices.subspan(position, end - position);
+						if (isVertexPulling)
+						{
+							kernels::PackSpriteRecords(spriteStreams, run, records.subspan(position, run.size()));
+						}
+						else if (isPacked)
+						{
+							expandPackedQuads(spriteStreams, run,
+											  packedVertices.subspan(position * verticesPerSprite,
+																	 run.size() * verticesPerSprite));
+						}
+						else
+						{
+							expandQuads(
+								spriteStreams, run,
+								vertices.subspan(position * verticesPerSprite, run.size() * verticesPerSprite));
+						}
+						position = end;
+					}
+				});
+}
+
+void SpriteBatch::GenerateSpriteLayers(std::span<const u32> indices, float* destination) const
+{
+	for (auto i = size_t{ 0 }; i < indices.size(); i++)
+	{
+		destination[i] = spriteStreams.transforms[indices[i]].w;
+	}
+}
+
+void SpriteBatch::SpriteStreams::Push(const SpriteInfo& sprite)
+{
+	destinations.push_back(vec4{ sprite.destination.position, sprite.destination.extent });
+	uvRects.push_back(sprite.uvRect);
+	transforms.push_back(vec4{ sprite.origin.x, sprite.origin.y, sprite.rotation, sprite.layer });
+	colors.push_back(sprite.color);
+	flags.push_back(PackFlags(sprite));
+	textureArrays.push_back(sprite.textureArray);
+	blendModes.push_back(sprite.blendMode);
+}
+
+void SpriteBatch::SpriteStreams::Resize(const u32 count)
+{
+	destinations.resize(count);
+	uvRects.resize(count);
+	transforms.resize(count);
+	colors.resize(count);
+	flags.resize(count);
+	textureArrays.resize(count);
+	blendModes.resize(count);
+}
+
+void SpriteBatch::SpriteStreams::Set(const u32 index, const SpriteInfo& sprite)
+{
+	destinations[index] = vec4{ sprite.destination.position, sprite.destination.extent };
+	uvRects[index] = sprite.uvRect;
+	transforms[index] = vec4{ sprite.origin.x, sprite.origin.y, sprite.rotation, sprite.layer };
+	colors[index] = sprite.color;
+	flags[index] = PackFlags(sprite);
+	textureArrays[index] = sprite.textureArray;
+	blendModes[index] = sprite.blendMode;
+}
+
+void SpriteBatch::SpriteStreams::Clear()
+{
+	destinations.clear();
+	uvRects.clear();
+	transforms.clear();
+	colors.clear();
+	flags.clear();
+	textureArrays.clear();
+	blendModes.clear();
+}
+
+void SpriteBatch::ParallelFor(const u32 count, const WorkerPool::RangeJob& job)
+{
+	// above the threshold the job runs in chunks on the worker pool
+	if (count < parallelThreshold)
+	{
+		job(0, count);
+	}
+	else
+	{
+		GetWorkerPool().ParallelFor(count, parallelChunkSize, job);
+	}
+}
+
+SpriteBatch::DrawElementsIndirectCommand SpriteBatch::MakeDrawCommand(const Batch& batch, const u32 firstVertex)
+{
+	// every batch draws the shared quad index pattern from its start, the base vertex selects its sprites
+	return DrawElementsIndirectCommand{ .count = batch.spriteCount * indicesPerSprite,
+										.instanceCount = 1,
+										.firstIndex = 0,
+										.baseVertex = static_cast<i32>(firstVertex +
+																	   batch.firstSprite * verticesPerSprite),
+										.baseInstance = batch.drawParameters };
+}
+
+void SpriteBatch::DrawCommandGroups(std::span<const DrawGroup> groups, const size_t commandOffset,
+									const bool premultiplied)
+{
+	auto& state = renderContext->GetStateCache();
+	const auto opaquePipeline = renderContext->Get(opaqueSpriteBatchPipeline).nativeHandle;
+	for (const auto& group : groups)
+	{
+		// custom shaders never see opaque groups, they are asserted to run without depth testing
+		state.BindProgramPipeline(group.blendMode == SpriteBlendMode::opaque ? opaquePipeline : passPipeline);
+		BindBlendState(state, group.blendMode, premultiplied, debugView);
+		state.BindTextures(0, static_cast<GLsizei>(group.textureCount), group.textureArrays.data());
+
+		const auto groupOffset = commandOffset + group.firstCommand * sizeof(DrawElementsIndirectCommand);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(groupOffset),
+									static_cast<GLsizei>(group.commandCount), 0);
+		passStats.drawCalls++;
+	}
+}
+
+void SpriteBatch::BuildDrawGroups()
+{
+	drawGroups.clear();
+	for (auto i = u32{ 0 }; i < batches.size(); i++)
+	{
+		auto& batch = batches[i];
+		auto* group = drawGroups.empty() ? nullptr : &drawGroups.back();
+		auto slot = u32{ 0 };
+		if (group)
+		{
+			const auto groupTextures = std::span{ group->textureArrays }.first(group->textureCount);
+			slot = static_cast<u32>(std::find(groupTextures.begin(), groupTextures.end(), batch.textureArray) -
+									groupTextures.begin());
+		}
+		const auto startsGroup = group == nullptr or group->blendMode != batch.blendMode or
+			(slot == group->textureCount and group->textureCount == textureSlotCount);
+		if (startsGroup)
+		{
+			group = &drawGroups.emplace_back(DrawGroup{ .firstCommand = i, .blendMode = batch.blendMode });
+			slot = 0;
+		}
+		if (slot == group->textureCount)
+		{
+			group->textureArrays[group->textureCount++] = batch.textureArray;
+		}
+		group->commandCount++;
+		batch.drawParameters |= slot << drawTextureSlotShift;
+	}
+}
+
+void SpriteBatch::SetSubmissionMode(const SpriteSubmissionMode mode)
+{
+	assert(spriteStreams.IsEmpty());
+	submissionMode = mode;
+}
+
+void SpriteBatch::SetVertexFormat(const SpriteVertexFormat format)
+{
+	assert(spriteStreams.IsEmpty());
+	vertexFormat = format;
+}
+
+void SpriteBatch::SetPremultipliedAlpha(const bool enabled)
+{
+	assert(spriteStreams.IsEmpty());
+	premultipliedAlpha = enabled;
+}
+
+void SpriteBatch::SetDepthTesting(const bool enabled)
+{
+	assert(spriteStreams.IsEmpty());
+	depthTesting = enabled;
+}
+
+void SpriteBatch::SetDebugView(const SpriteDebugView view)
+{
+	assert(spriteStreams.IsEmpty());
+	debugView = view;
 }
 
 void SpriteBatch::Draw(const Texture2DHandle texture, const vec2& postion, const Color& color)
 {
-	const auto& textureData = renderContext->Get(texture);
-	const auto source = Rectangle{ { 0.0f, 0.0f }, { textureData.width, textureData.height } };
-	const auto destination = Rectangle{ postion, { textureData.width, textureData.height } };
+	ResolveTexture(texture);
+	const auto source = Rectangle{ { 0.0f, 0.0f }, resolvedTextureExtent };
+	const auto destination = Rectangle{ postion, resolvedTextureExtent };
 
 	Draw(texture, source, destination, color);
 }
 
 void SpriteBatch::Draw(const Texture2DHandle texture, const Rectangle& destination, const Color& color)
 {
-	const auto& textureData = renderContext->Get(texture);
-	const auto source = Rectangle{ { 0.0f, 0.0f }, { textureData.width, textureData.height } };
+	ResolveTexture(texture);
+	const auto source = Rectangle{ { 0.0f, 0.0f }, resolvedTextureExtent };
 
 	Draw(texture, source, destination, color);
 }
 
+void SpriteBatch::Draw(const Texture2DHandle texture, const vec2& position, const Rectangle& source,
+					   const Color& color, const float rotation, const vec2& origin, const vec2& scale,
+					   const FlipSprite flip, const float layer)
+{
+	const auto scaledOrigin = origin * scale;
+	const auto destination = Rectangle{ position - scaledOrigin, source.extent * scale };
+
+	Draw(texture, source, destination, color, flip, scaledOrigin, rotation, layer);
+}
+
 void SpriteBatch::Draw(const Texture2DHandle texture, const Rectangle& source, const Rectangle& destination,
 					   const Color& color, const FlipSprite flip, const vec2& origin, float rotation, float layer)
 {
 	// ZoneScoped;
-	spriteInfos.push_back(SpriteInfo{ .texture = texture,
-									  .source = source,
-									  .destination = destination,
-									  .flip = flip,
-									  .origin = origin,
-									  .rotation = rotation,
-									  .layer = layer,
-									  .color = color });
-}
\ No newline at end of file
+	ResolveTexture(texture);
+	const auto uv0 = source.position / resolvedTextureExtent;
+	const auto uv1 = (source.position + source.extent) / resolvedTextureExtent;
+
+	Enqueue(SpriteInfo{ .textureArray = resolvedTextureArray,
+						.textureLayer = resolvedTextureLayer,
+						.uvRect = vec4{ uv0, uv1 },
+						.destination = destination,
+						.flip = flip,
+						.origin = origin,
+						.rotation = rotation,
+						.layer = layer,
+						.color = color,
+						.blendMode = blendMode });
+}
+
+void SpriteBatch::Draw(const SpriteRegion& region, const vec2& position, const Color& color)
+{
+	Draw(region, Rectangle{ position, region.extent }, color);
+}
+
+void SpriteBatch::Draw(const SpriteRegion& region, const Rectangle& destination, const Color& color,
+					   const FlipSprite flip, const vec2& origin, float rotation, float layer)
+{
+	Enqueue(SpriteInfo{ .textureArray = region.textureArray,
+						.textureLayer = region.textureLayer,
+						.uvRect = region.uvRect,
+						.destination = destination,
+						.flip = flip,
+						.origin = origin,
+						.rotation = rotation,
+						.layer = layer,
+						.color = color,
+						.blendMode = blendMode });
+}
+
+void SpriteBatch::DrawRange(std::span<const SpriteInfo> sprites)
+{
+	DrawRange(sprites.data(), static_cast<u32>(sprites.size()), sizeof(SpriteInfo));
+}
+
+void SpriteBatch::DrawRange(const SpriteInfo* first, const u32 count, const size_t stride)
+{
+	const auto spriteAt = [&](const u32 index) -> const SpriteInfo&
+	{ return *reinterpret_cast<const SpriteInfo*>(reinterpret_cast<const std::byte*>(first) + index * stride); };
+
+	// the immediate mode checks every sprite for a texture array or blend mode change anyway
+	if (sortMode == SpriteSortMode::immediate and not isRecording)
+	{
+		for (auto i = u32{ 0 }; i < count; i++)
+		{
+			Enqueue(spriteAt(i));
+		}
+		return;
+	}
+
+	const auto firstSprite = spriteStreams.Size();
+	spriteStreams.Resize(firstSprite + count);
+	sortKeys.resize(firstSprite + count);
+	if (cullingEnabled and not isRecording)
+	{
+		// culled sprites leave no gap, every sequence number depends on the sprites before it
+		auto sequence = firstSprite;
+		for (auto i = u32{ 0 }; i < count; i++)
+		{
+			const auto& sprite = spriteAt(i);
+			if (IsOutsideView(sprite))
+			{
+				culledSpriteCount++;
+				continue;
+			}
+			spriteStreams.Set(sequence, sprite);
+			sortKeys[sequence] = ComputeSortKey(sprite, sequence);
+			sequence++;
+		}
+		spriteStreams.Resize(sequence);
+		sortKeys.resize(sequence);
+		return;
+	}
+
+	ParallelFor(count,
+				[&](const u32 begin, const u32 end)
+				{
+					for (auto i = begin; i < end; i++)
+					{
+						const auto sequence = firstSprite + i;
+						spriteStreams.Set(sequence, spriteAt(i));
+						sortKeys[sequence] = ComputeSortKey(spriteAt(i), sequence);
+					}
+				});
+}
+
+void SpriteBatch::ResolveTexture(const Texture2DHandle texture)
+{
+	if (resolvedTexture != texture)
+	{
+		const auto& textureData = renderContext->GetSpriteTexture(texture);
+		resolvedTexture = texture;
+		resolvedTextureArray = textureData.arrayNativeHandle;
+		resolvedTextureLayer = textureData.arrayLayer;
+		resolvedTextureExtent = vec2{ textureData.width, textureData.height };
+	}
+}
+
+bool SpriteBatch::IsOutsideView(const SpriteInfo& sprite) const
+{
+	// the expanded quads are one pixel larger than the destination, see ComputeQuadCorners
+	const auto extent = sprite.destination.extent + vec2{ 1.0f, 1.0f };
+	auto boundsMin = glm::min(sprite.destination.position, sprite.destination.position + extent);
+	auto boundsMax = glm::max(sprite.destination.position, sprite.destination.position + extent);
+	if (sprite.rotation != 0.0f)
+	{
+		// any rotation around the pivot stays inside the circle through the farthest corner
+		const auto pivot = sprite.destination.position + sprite.origin;
+		const auto radius = glm::length(glm::max(glm::abs(sprite.origin), glm::abs(extent - sprite.origin)));
+		boundsMin = pivot - vec2{ radius };
+		boundsMax = pivot + vec2{ radius };
+	}
+	return boundsMax.x < visibleMin.x or boundsMax.y < visibleMin.y or boundsMin.x > visibleMax.x or
+		boundsMin.y > visibleMax.y;
+}
+
+void SpriteBatch::Enqueue(const SpriteInfo& sprite)
+{
+	if (cullingEnabled and not isRecording and IsOutsideView(sprite))
+	{
+		culledSpriteCount++;
+		return;
+	}
+
+	// the immediate mode submits the queued sprites as soon as the next one would start a new batch
+	if (sortMode == SpriteSortMode::immediate and not isRecording and not spriteStreams.IsEmpty())
+	{
+		const auto changesTexture = sprite.textureArray != spriteStreams.textureArrays.back();
+		const auto changesBlendMode =
+			ResolveBlendMode(sprite.blendMode) != ResolveBlendMode(spriteStreams.blendModes.back());
+		if (changesTexture or changesBlendMode)
+		{
+			Flush();
+		}
+	}
+
+	const auto sequence = spriteStreams.Size();
+	spriteStreams.Push(sprite);
+	sortKeys.push_back(ComputeSortKey(sprite, sequence));
+}
+
+u64 SpriteBatch::ComputeSortKey(const SpriteInfo& sprite, const u32 sequence) const
+{
+	const auto blendMode = ResolveBlendMode(sprite.blendMode);
+	return depthTesting ? MakeDepthSortKey(sprite, blendMode, sequence) :
+						  MakeSortKey(sortMode, sprite, blendMode, sequence);
+}
@@ -1,24 +1,36 @@
 #pragma once
 
+#include <array>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <type_traits>
 #include <vector>
 
 #include "Color.hpp"
 #include "Common.hpp"
+#include "FrameStats.hpp"
 #include "RenderResources.hpp"
+#include "StreamingBuffer.hpp"
+#include "WorkerPool.hpp"
 
 struct RenderContext;
+struct SpriteRegion;
+struct StaticSpriteCache;
+struct SpriteRecorder;
 
-struct Buffer
-{
-	GLuint nativeHandle{};
-	void* mappedPtr{ nullptr };
-};
-
+// std140 block spriteBatchConstants of the sprite shaders
 struct SpriteBatchConstants
 {
 	vec2 viewportSize;
-	vec2 pad;
+	u32 vertexPulling;
+	u32 premultipliedAlpha;
 	mat4 transform;
+	u32 debugView;
+	u32 depthTesting;
+	vec2 pad;
 };
 
 enum class FlipSprite
@@ -29,59 +41,516 @@ enum class FlipSprite
 	horizontalAndVertical
 };
 
+/*
+	cpuExpansion: End() expands every sprite into four vertices on the cpu and uploads them.
+	vertexPulling: End() uploads one compact SpriteRecord per sprite into a storage buffer and the vertex shader
+	builds the quad corners from gl_VertexID.
+*/
+enum class SpriteSubmissionMode
+{
+	cpuExpansion,
+	vertexPulling
+};
+
+/*
+	Vertex layout of the cpuExpansion mode.
+	float32: 32 bytes per vertex, float position, uv and color.
+	packed: 16 bytes per vertex, float position, unorm16 uv, unorm8 rgb color and the texture array layer in the last
+	byte. The color bytes are copied as they are, so End() has no color conversion left to do.
+*/
+enum class SpriteVertexFormat
+{
+	float32,
+	packed
+};
+
+/*
+	Order in which End() submits the sprites, modeled after XNA/MonoGame.
+	deferred: submission order, consecutive sprites with the same texture share a batch.
+	immediate: submission order, the queued sprites are submitted as soon as the texture array or blend mode changes.
+	texture: grouped by texture, submission order within a texture.
+	backToFront: descending layer, e.g. layer 1.0 is drawn first and 0.0 last.
+	frontToBack: ascending layer.
+	ySort: ascending bottom edge of the destination, for top-down scenes.
+	All sorted modes keep the submission order between sprites with equal keys.
+*/
+enum class SpriteSortMode
+{
+	deferred,
+	immediate,
+	texture,
+	backToFront,
+	frontToBack,
+	ySort
+};
+
+/*
+	Blend function of a sprite, part of the batch key next to the texture.
+	alpha: source over destination.
+	additive: the color is added to the destination, e.g. for glows and particles.
+	multiply: the destination is multiplied by the color, e.g. for shadows.
+	opaque: drawn without blending or alpha test, the texture has to cover the whole quad. With depth testing these
+	sprites are drawn first, front to back and writing depth through a shader without discard, so the early depth
+	test holds for them as well. Without depth testing they are blended like alpha.
+	cutout: like opaque, but alpha tested: texels below half alpha are discarded. The discard turns off the early
+	depth test for their own fragments, with depth testing they are drawn after the opaque sprites.
+	With premultiplied alpha the shader premultiplies the texture color and additive sprites output zero alpha, so
+	alpha and additive sprites share one blend function and only multiply sprites break the batch.
+*/
+enum class SpriteBlendMode : u8
+{
+	alpha,
+	additive,
+	multiply,
+	opaque,
+	cutout
+};
+
+/*
+	Debug visualizations of the sprite draws.
+	overdraw: every shaded fragment adds one into the count target of RenderContext::GetOverdrawFramebuffer(), see
+	RenderContext::BeginOverdrawCapture().
+	batches: sprites are tinted with a color derived from the index of their batch, so neighbouring draws differ and
+	texture or blend mode changes that split draws become visible.
+*/
+enum class SpriteDebugView
+{
+	none,
+	overdraw,
+	batches
+};
+
 struct Effect;
 
 struct SpriteBatch
 {
-	SpriteBatch(RenderContext* context);
+	SpriteBatch(RenderContext* context, const SpriteSubmissionMode mode = SpriteSubmissionMode::cpuExpansion);
 	virtual ~SpriteBatch();
 
-	void Begin(const mat3& transform = mat3{ 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f }, Effect* effect = nullptr);
+	/*
+		Without a sampler the textures are sampled with nearest filtering and repeat addressing. An effect replaces
+		the framebuffer and, unless it is a DefaultSpriteBatchEffect, the shaders of the pass. Custom shaders like
+		NonDefaultSpriteBatch only implement the cpuExpansion submission with straight alpha and no depth: vertex
+		pulling, premultiplied alpha, depth testing with its opaque and cutout sprites and the debug views are
+		asserted off for them, for the StaticSpriteCache draws of the pass as well.
+	*/
+	void Begin(const mat3& transform = mat3{ 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f },
+			   Effect* effect = nullptr, const SpriteSortMode sortMode = SpriteSortMode::texture,
+			   const std::optional<SamplerHandle> sampler = std::nullopt);
 	void End();
 
+	/*
+		Between BeginRecording() and EndRecording() the Draw() calls are not submitted but recorded once into a gpu
+		resident StaticSpriteCache, sorted and split into batches like End() would. Drawing the cache inside
+		Begin()/End() costs a few bind calls and one multi draw per 16 texture arrays, the transform passed to Begin()
+		applies to it. The cache is drawn by the batch that recorded it and keeps the texture array bindings of the
+		recorded textures.
+	*/
+	void BeginRecording(const SpriteSortMode sortMode = SpriteSortMode::texture);
+	std::unique_ptr<StaticSpriteCache> EndRecording();
+	void Draw(const StaticSpriteCache& cache);
+
+	// the recorder is merged at End() or EndRecording(), after the sprites drawn directly and after the recorders
+	// added before it; it has to stay alive and untouched until then
+	void Add(SpriteRecorder& recorder);
+
 	void Draw(const Texture2DHandle texture, const vec2& postion, const Color& color = Colors::White);
 	void Draw(const Texture2DHandle texture, const Rectangle& destination, const Color& color = Colors::White);
+	// origin is the rotation pivot relative to the top left corner of the destination, rotation is in radians
 	void Draw(const Texture2DHandle texture, const Rectangle& source, const Rectangle& destination,
 			  const Color& color = Colors::White, const FlipSprite flip = FlipSprite::none,
 			  const vec2& origin = vec2{ 0.0f, 0.0f }, float rotation = 0.0f, float layer = 0.0f);
+	// XNA style: origin is given in source pixels and is placed at position, the sprite is scaled and rotated around it
+	void Draw(const Texture2DHandle texture, const vec2& position, const Rectangle& source, const Color& color,
+			  const float rotation, const vec2& origin, const vec2& scale, const FlipSprite flip = FlipSprite::none,
+			  const float layer = 0.0f);
+	// regions carry their texture binding and normalized source, drawing them needs no texture lookup
+	void Draw(const SpriteRegion& region, const vec2& position, const Color& color = Colors::White);
+	void Draw(const SpriteRegion& region, const Rectangle& destination, const Color& color = Colors::White,
+			  const FlipSprite flip = FlipSprite::none, const vec2& origin = vec2{ 0.0f, 0.0f }, float rotation = 0.0f,
+			  float layer = 0.0f);
+
+	// blend mode of the following Draw() calls, Begin() and BeginRecording() reset it to alpha
+	void SetBlendMode(const SpriteBlendMode mode)
+	{
+		blendMode = mode;
+	}
+	SpriteBlendMode GetBlendMode() const
+	{
+		return blendMode;
+	}
+
+	// must not be changed between Begin() and End(), a StaticSpriteCache keeps the setting it was recorded with
+	void SetPremultipliedAlpha(const bool enabled);
+	bool IsPremultipliedAlpha() const
+	{
+		return premultipliedAlpha;
+	}
+
+	/*
+		With depth testing the layer of every sprite is written as depth, layer 0 is the front and 1 the back, layers
+		outside are clamped. End() draws the opaque and then the cutout sprites front to back first, so the early depth
+		test rejects what they cover, then the remaining sprites back to front without writing depth. The sort mode
+		passed to Begin() is ignored. The vertex shader derives the depth per sprite, the cpu expanded quads read
+		their layers from an extra per sprite buffer. Must not be changed between Begin() and End(), a
+		StaticSpriteCache keeps the setting it was recorded with.
+	*/
+	void SetDepthTesting(const bool enabled);
+	bool IsDepthTesting() const
+	{
+		return depthTesting;
+	}
+
+	// must not be changed between Begin() and End()
+	void SetDebugView(const SpriteDebugView view);
+	SpriteDebugView GetDebugView() const
+	{
+		return debugView;
+	}
+
+	// below this sprite count End() generates vertices on the calling thread only
+	void SetParallelThreshold(const u32 spriteCount)
+	{
+		parallelThreshold = spriteCount;
+	}
+
+	// must not be changed between Begin() and End()
+	void SetSubmissionMode(const SpriteSubmissionMode mode);
+	SpriteSubmissionMode GetSubmissionMode() const
+	{
+		return submissionMode;
+	}
+
+	// must not be changed between Begin() and End()
+	void SetVertexFormat(const SpriteVertexFormat format);
+	SpriteVertexFormat GetVertexFormat() const
+	{
+		return vertexFormat;
+	}
+
+	/*
+		With culling enabled Draw() drops sprites outside the area the framebuffer shows under the Begin() transform,
+		before they are queued, sorted or expanded. Rotated sprites are tested by the circle around their pivot.
+		Recorded sprites and StaticSpriteCache draws are never culled.
+	*/
+	void SetCulling(const bool enabled)
+	{
+		cullingEnabled = enabled;
+	}
+	bool IsCullingEnabled() const
+	{
+		return cullingEnabled;
+	}
+	// sprites dropped by culling since the last Begin()
+	u32 GetCulledSpriteCount() const
+	{
+		return culledSpriteCount;
+	}
+
+	// largest number of sprites queued between two flushes so far; batches above flushChunkSpriteCount are drawn in
+	// several chunks
+	u32 GetSpriteHighWaterMark() const
+	{
+		return spriteHighWaterMark;
+	}
+
+	// counters of this batch since its first Begin() in the current frame of the RenderContext, the gpu time is
+	// reported by the RenderContext under the pass name "SpriteBatch"
+	const FrameStats& GetFrameStats() const
+	{
+		return frameStats;
+	}
 
 private:
 	GraphicsPipelineHandle defaultSpriteBatchPipeline;
-	Buffer uniformBuffer;
-	u32 uniformConstantsSize{};
-	
+	// the default shaders without the alpha test discard, bound for the opaque draw groups
+	GraphicsPipelineHandle opaqueSpriteBatchPipeline;
+	SamplerHandle defaultSampler;
+	u32 uniformBufferAlignment{};
+	u32 storageBufferAlignment{};
+
+public:
 	struct SpriteQuadVertex
 	{
 		vec2 position;
 		vec2 uv;
-		vec4 color;
+		vec3 color;
+		float textureLayer;
+	};
+	struct PackedSpriteQuadVertex
+	{
+		vec2 position;
+		std::array<u16, 2> uv;
+		std::array<u8, 4> colorAndTextureLayer;
+	};
+	static constexpr u32 verticesPerSprite = 4;
+	static constexpr u32 indicesPerSprite = 6;
+
+	// sprite flags: FlipSprite bits, additiveFlagBit and the texture array layer from bit textureLayerShift on
+	// set for additive sprites, the shader drops their alpha in the premultiplied alpha mode
+	static constexpr u32 additiveFlagShift = 2;
+	static constexpr u32 additiveFlagBit = 1u << additiveFlagShift;
+	static constexpr u32 textureLayerShift = 8;
+	/*
+		The texture layer attribute of the cpu expanded vertices carries the layer shifted by vertexLayerShift and
+		the additive bit below it. The packed vertices store it in one byte, so they only address the layers below
+		maxPackedTextureLayers.
+	*/
+	static constexpr u32 vertexAdditiveBit = 1;
+	static constexpr u32 vertexLayerShift = 1;
+	static constexpr u32 maxPackedTextureLayers = 128;
+
+	// size of the sampler array in the sprite shaders, one multi draw binds at most this many texture arrays and every
+	// draw samples the unit selected by the slot in its draw parameters
+	static constexpr u32 textureSlotCount = 16;
+
+	/*
+		Base instance of the draw commands, read as gl_BaseInstance by the sprite shaders: the alpha test bit, the
+		texture slot of the batch within its multi draw and the batch index for the batch debug view.
+	*/
+	static constexpr u32 drawAlphaTestBit = 1;
+	static constexpr u32 drawTextureSlotShift = 1;
+	static constexpr u32 drawBatchIndexShift = 5;
+
+	// #defines of the constants above shared with the sprite shaders, prepended to the default and the effect shaders
+	static std::string GetShaderDefines();
+
+	/*
+		Consecutive draw commands submitted by one glMultiDrawElementsIndirect: they share the blend function and
+		sample at most textureSlotCount distinct texture arrays, commands of the same array share its slot. A group
+		only ends on a blend function change or when one more array would not fit.
+	*/
+	struct DrawGroup
+	{
+		u32 firstCommand{ 0 };
+		u32 commandCount{ 0 };
+		SpriteBlendMode blendMode{ SpriteBlendMode::alpha }; // resolved
+		u32 textureCount{ 0 };
+		std::array<GLuint, textureSlotCount> textureArrays{};
 	};
-	std::vector<SpriteQuadVertex> generatedVertices;
+
+	// per sprite storage buffer entry of the vertex pulling mode, must match the std430 layout in
+	// DefaultSpriteBatch.vert
+	struct SpriteRecord
+	{
+		vec4 destination;
+		std::array<u16, 4> uvRect; // unorm16 u0, v0, u1, v1 without flip applied
+		u32 color;
+		u32 flags; // see additiveFlagBit
+		vec2 origin;
+		float rotation;
+		float layer;
+	};
+
+private:
+	void Flush();
+	// fills sortedIndices with the draw order of the queued sprites
+	std::span<const u32> SortSprites();
+	// generates and draws one chunk of sorted sprites
+	void SubmitSprites(std::span<const u32> indices);
+	// splits one chunk of sorted sprites into batches
+	void BuildBatches(std::span<const u32> indices);
+	// writes the vertices or records of one chunk of sorted sprites, the batches have to be built
+	void GenerateSprites(std::span<const u32> indices, void* destination);
+	// the layer of every sprite for the depth of the cpu expanded quads, read as SpriteLayers by the vertex shader
+	void GenerateSpriteLayers(std::span<const u32> indices, float* destination) const;
+	void ParallelFor(const u32 count, const WorkerPool::RangeJob& job);
+	// splits the batches into draw groups and stores the texture slot of every batch in its draw parameters
+	void BuildDrawGroups();
+	// multi draws the commands of the bound indirect buffer, one call per group
+	void DrawCommandGroups(std::span<const DrawGroup> groups, const size_t commandOffset, const bool premultiplied);
+	void BindSubmissionState();
+	void BindConstants(const SpriteBatchConstants& uniformConstants);
+	u32 GetBytesPerSprite() const;
+	// bytes allocated from the streaming rings so far
+	u64 GetUploadedBytes() const;
+	// refreshes the cached array binding and extent when texture differs from the last drawn one
+	void ResolveTexture(const Texture2DHandle texture);
+	// additive sprites share the alpha blend function with premultiplied alpha, opaque and cutout ones only differ
+	// from alpha with depth testing
+	SpriteBlendMode ResolveBlendMode(const SpriteBlendMode mode) const
+	{
+		if ((premultipliedAlpha and mode == SpriteBlendMode::additive) or
+			(not depthTesting and (mode == SpriteBlendMode::opaque or mode == SpriteBlendMode::cutout)))
+		{
+			return SpriteBlendMode::alpha;
+		}
+		return mode;
+	}
+
+	SpriteSubmissionMode submissionMode{ SpriteSubmissionMode::cpuExpansion };
+	SpriteVertexFormat vertexFormat{ SpriteVertexFormat::float32 };
+	SpriteSortMode sortMode{ SpriteSortMode::texture };
+	bool isRecording{ false };
+	SpriteBatchConstants constants{};
+	SpriteBlendMode blendMode{ SpriteBlendMode::alpha };
+	bool premultipliedAlpha{ false };
+	bool depthTesting{ false };
+	SpriteDebugView debugView{ SpriteDebugView::none };
+	// the pass draws with the shaders of a custom effect, see Begin()
+	bool usesCustomShaders{ false };
+	// program pipeline of the pass for every draw group but the opaque ones
+	GLuint passPipeline{ 0 };
+
+	bool cullingEnabled{ false };
+	u32 culledSpriteCount{ 0 };
+
+	// counters of the current Begin()/End() pair and of all pairs in the current frame
+	FrameStats passStats{};
+	FrameStats frameStats{};
+	u64 frameStatsIndex{ ~u64{ 0 } };
+	u64 passFirstStateChanges{ 0 };
+	u64 passFirstUploadedBytes{ 0 };
+	// world space bounds of the framebuffer under the Begin() transform
+	vec2 visibleMin{ 0.0f, 0.0f };
+	vec2 visibleMax{ 0.0f, 0.0f };
+
+	// the array binding and extent of the last drawn texture, consecutive sprites mostly share their texture
+	std::optional<Texture2DHandle> resolvedTexture;
+	GLuint resolvedTextureArray{ 0 };
+	u32 resolvedTextureLayer{ 0 };
+	vec2 resolvedTextureExtent{ 0.0f, 0.0f };
+	// run of sprites in sorted order that share a texture array and resolved blend mode; every batch draws the
+	// shared quad index pattern from its start, the base vertex derived from firstSprite selects its vertices
 	struct Batch
 	{
-		Texture2DHandle texture;
-		u32 vertexOffset;
-		u32 vertexCount;
+		GLuint textureArray;
+		u32 firstSprite;
+		u32 spriteCount;
+		SpriteBlendMode blendMode; // resolved
+		u32 drawParameters;		   // base instance of the draw command, see PackDrawParameters()
 	};
 	std::vector<Batch> batches;
+	std::vector<DrawGroup> drawGroups;
+	std::vector<u32> chunkBatchCounts;
+
+	u32 parallelThreshold{ 16 * 1024 };
+	static constexpr u32 parallelChunkSize = 4 * 1024;
 
 public:
+	// one sprite as passed to Draw() and SpriteRecorder
 	struct SpriteInfo
 	{
-		Texture2DHandle texture;
-		Rectangle source;
+		GLuint textureArray;
+		u32 textureLayer;
+		vec4 uvRect; // normalized u0, v0, u1, v1 without flip applied
 		Rectangle destination;
 		FlipSprite flip;
 		vec2 origin;
 		float rotation;
 		float layer;
 		Color color;
+		SpriteBlendMode blendMode;
 	};
-	std::vector<SpriteBatch::SpriteInfo> spriteInfos;
+	/*
+		Bulk submission of filled in sprites, e.g. tile layers or particles that already keep their sprites in arrays.
+		The streams and sort keys grow once for the whole range and the sprites are written straight into them, large
+		ranges in parallel. Culling applies like for Draw(), the blend mode is taken from every sprite instead of
+		SetBlendMode().
+	*/
+	void DrawRange(std::span<const SpriteInfo> sprites);
+	// stride is the distance in bytes between two consecutive sprites
+	void DrawRange(const SpriteInfo* first, const u32 count, const size_t stride);
+	// sprites embedded in larger elements, e.g. DrawRange(particles, &Particle::sprite)
+	template <std::ranges::contiguous_range Range, typename Element>
+	void DrawRange(const Range& elements, SpriteInfo Element::*sprite)
+	{
+		static_assert(std::is_same_v<std::ranges::range_value_t<Range>, Element>);
+		if (not std::ranges::empty(elements))
+		{
+			DrawRange(&(std::ranges::data(elements)->*sprite), static_cast<u32>(std::ranges::size(elements)),
+					  sizeof(Element));
+		}
+	}
+	/*
+		Queue of the sprites between two flushes, one stream per group of fields that is read together: the batch
+		scan reads textureArrays and blendModes only, the SIMD kernels load destinations, uvRects and transforms as
+		whole vectors. Element i of every stream belongs to sprite i in submission order, the sort only permutes
+		sortedIndices.
+	*/
+	struct SpriteStreams
+	{
+		std::vector<vec4> destinations; // x, y, width, height
+		std::vector<vec4> uvRects;		// normalized u0, v0, u1, v1 without flip applied
+		std::vector<vec4> transforms;	// origin x, origin y, rotation, layer
+		std::vector<Color> colors;
+		// FlipSprite bits, additiveFlagBit and texture array layer, see additiveFlagBit
+		std::vector<u32> flags;
+		std::vector<GLuint> textureArrays;
+		std::vector<SpriteBlendMode> blendModes;
 
+		u32 Size() const
+		{
+			return static_cast<u32>(destinations.size());
+		}
+		bool IsEmpty() const
+		{
+			return destinations.empty();
+		}
+		void Push(const SpriteInfo& sprite);
+		void Resize(const u32 count);
+		void Set(const u32 index, const SpriteInfo& sprite);
+		void Clear();
+	};
+	SpriteStreams spriteStreams;
+
+private:
+	// queues a filled in sprite, in the immediate sort mode after flushing the sprites of a different batch
+	void Enqueue(const SpriteInfo& sprite);
+	u64 ComputeSortKey(const SpriteInfo& sprite, const u32 sequence) const;
+	bool IsOutsideView(const SpriteInfo& sprite) const;
+	// appends the sprites of all added recorders, culled and with their sort keys, and clears the recorders
+	void MergeRecorders();
+
+public:
+	// one key per sprite: sort mode dependent primary key in the high half, sequence number in the low half
+	std::vector<u64> sortKeys;
+	std::vector<u32> sortedIndices;
+	std::vector<u32> sortScratch;
+	std::vector<SpriteRecorder*> recorders;
+	std::vector<u32> recorderOffsets;
+
+	using ExpandQuadsFunction = void (*)(const SpriteStreams& sprites, std::span<const u32> indices,
+										 std::span<SpriteQuadVertex> vertices);
+	using ExpandPackedQuadsFunction = void (*)(const SpriteStreams& sprites, std::span<const u32> indices,
+											   std::span<PackedSpriteQuadVertex> vertices);
+	// vertex expansion kernel, picked on construction based on the cpu features
+	ExpandQuadsFunction expandQuads{ nullptr };
+	ExpandPackedQuadsFunction expandPackedQuads{ nullptr };
+
+	// layout consumed by glMultiDrawElementsIndirect
+	struct DrawElementsIndirectCommand
+	{
+		u32 count;
+		u32 instanceCount;
+		u32 firstIndex;
+		i32 baseVertex;
+		u32 baseInstance;
+	};
+
+private:
+	static DrawElementsIndirectCommand MakeDrawCommand(const Batch& batch, const u32 firstVertex);
+
+public:
 	// openGL specific fields
-	GLuint vertexBuffer;
+	// vertices/sprite records, constants and draw commands are written straight into persistently mapped, fenced
+	// rings
+	std::unique_ptr<StreamingBuffer> vertexStream;
+	std::unique_ptr<StreamingBuffer> constantsStream;
+	std::unique_ptr<StreamingBuffer> drawCommandStream;
+	GLuint indexBuffer;
 	GLuint vertexArrayObject;
-	const u32 defaultBufferSize = 16 * 1024 * 1024;
+	GLuint packedVertexArrayObject;
+	GLuint vertexPullingArrayObject;
+	static constexpr u32 defaultBufferSize = 16 * 1024 * 1024;
+	static constexpr u32 streamingSegmentCount = 3;
+	static constexpr u32 constantsSegmentSize = 64 * 1024;
+	static constexpr u32 maxSpriteCount = defaultBufferSize / (verticesPerSprite * sizeof(SpriteQuadVertex));
+	// sprites per submitted chunk, four chunks fit into one ring segment
+	static constexpr u32 flushChunkSpriteCount = maxSpriteCount / 4;
+	// every sprite of a chunk may end up in its own batch
+	static constexpr u32 drawCommandSegmentSize = flushChunkSpriteCount * sizeof(DrawElementsIndirectCommand);
+	// largest sprite count seen by a single flush
+	u32 spriteHighWaterMark{ 0 };
 	RenderContext* renderContext;
 };
\ No newline at end of file
@@ -0,0 +1,479 @@
+#include "RecordingGl.hpp"
+#include "RenderContext.hpp"
+#include "SpriteBatch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+	Measures the cpu side of SpriteBatch, the Draw() submission and the sort, batching and sprite generation of End(),
+	headless on top of RecordingGl. Every combination of the option lists is run as one scenario and reported as JSON
+	on stdout. Options take comma separated lists:
+		--sprites=1000,10000,100000	sprites per frame
+		--textures=1,16,64			distinct 64x64 textures, every sprite picks one at random
+		--rotated=0,0.5				fraction of rotated sprites
+		--sort=deferred,texture,backToFront
+		--submission=cpuExpansion	or vertexPulling
+		--format=float32			or packed
+		--arrays=1					group the textures into texture arrays like SampleGame does, 0 or 1
+		--api=draw					one Draw() per sprite, or range for one DrawRange() over prebuilt SpriteInfos
+		--frames=50					measured frames per scenario, after a few warm up frames
+	The sprite data is generated up front from a fixed seed, so runs are comparable. The bench does not depend on
+	CopyAssets, so the shader sources load as empty strings; that only works because RecordingGl stubs
+	glCreateShaderProgramv and never compiles them.
+*/
+
+namespace
+{
+	std::atomic<u64> allocationCount{ 0 };
+	std::atomic<u64> allocatedBytes{ 0 };
+} // namespace
+
+// every heap allocation of the process is counted, including the ones of the worker threads
+void* operator new(std::size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	if (auto memory = std::malloc(size > 0 ? size : 1))
+	{
+		return memory;
+	}
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+namespace
+{
+	constexpr auto sortModeNames =
+		std::array{ "deferred", "immediate", "texture", "backToFront", "frontToBack", "ySort" };
+	constexpr auto submissionModeNames = std::array{ "cpuExpansion", "vertexPulling" };
+	constexpr auto vertexFormatNames = std::array{ "float32", "packed" };
+
+	enum class SubmissionApi
+	{
+		draw,
+		range
+	};
+	constexpr auto submissionApiNames = std::array{ "draw", "range" };
+
+	constexpr u32 textureSize = 64;
+	constexpr u32 warmUpFrameCount = 3;
+	constexpr u32 viewportWidth = 1920;
+	constexpr u32 viewportHeight = 1080;
+
+	struct Scenario
+	{
+		u32 spriteCount;
+		u32 textureCount;
+		f32 rotatedFraction;
+		SpriteSortMode sortMode;
+		SpriteSubmissionMode submissionMode;
+		SpriteVertexFormat vertexFormat;
+		bool textureArrays;
+		SubmissionApi api;
+	};
+
+	struct Options
+	{
+		std::vector<u32> spriteCounts{ 1000, 10000, 100000 };
+		std::vector<u32> textureCounts{ 1, 16, 64 };
+		std::vector<f32> rotatedFractions{ 0.0f, 0.5f };
+		std::vector<SpriteSortMode> sortModes{ SpriteSortMode::deferred, SpriteSortMode::texture,
+											   SpriteSortMode::backToFront };
+		std::vector<SpriteSubmissionMode> submissionModes{ SpriteSubmissionMode::cpuExpansion };
+		std::vector<SpriteVertexFormat> vertexFormats{ SpriteVertexFormat::float32 };
+		std::vector<bool> textureArrays{ true };
+		std::vector<SubmissionApi> apis{ SubmissionApi::draw };
+		u32 frameCount{ 50 };
+	};
+
+	struct Result
+	{
+		double seconds;
+		u64 streamedBytes;
+		u64 allocations;
+		u64 allocatedBytes;
+		RecordingGlCounters glCounters;
+	};
+
+	struct BenchSprite
+	{
+		u32 texture;
+		Rectangle destination;
+		vec2 origin;
+		float rotation;
+		float layer;
+		Color color;
+	};
+
+	std::vector<std::string_view> SplitList(std::string_view list)
+	{
+		auto items = std::vector<std::string_view>{};
+		while (not list.empty())
+		{
+			const auto comma = list.find(',');
+			items.push_back(list.substr(0, comma));
+			list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+		}
+		return items;
+	}
+
+	template <typename Enum, size_t count>
+	std::optional<Enum> ParseName(const std::string_view name, const std::array<const char*, count>& names)
+	{
+		for (auto i = size_t{ 0 }; i < count; i++)
+		{
+			if (name == names[i])
+			{
+				return static_cast<Enum>(i);
+			}
+		}
+		return std::nullopt;
+	}
+
+	// parses every item of list with parse, false if one of them is malformed
+	template <typename T, typename Parse>
+	bool ParseList(const std::string_view list, std::vector<T>& values, const Parse& parse)
+	{
+		values.clear();
+		for (const auto item : SplitList(list))
+		{
+			const auto value = parse(std::string{ item });
+			if (not value)
+			{
+				return false;
+			}
+			values.push_back(*value);
+		}
+		return not values.empty();
+	}
+
+	std::optional<u32> ParseCount(const std::string& text)
+	{
+		auto end = static_cast<char*>(nullptr);
+		const auto value = std::strtoul(text.c_str(), &end, 10);
+		if (end == text.c_str() or *end != '\0')
+		{
+			return std::nullopt;
+		}
+		return static_cast<u32>(value);
+	}
+
+	std::optional<f32> ParseFraction(const std::string& text)
+	{
+		auto end = static_cast<char*>(nullptr);
+		const auto value = std::strtof(text.c_str(), &end);
+		if (end == text.c_str() or *end != '\0' or value < 0.0f or value > 1.0f)
+		{
+			return std::nullopt;
+		}
+		return value;
+	}
+
+	bool ParseOption(const std::string_view argument, Options& options)
+	{
+		const auto equals = argument.find('=');
+		if (not argument.starts_with("--") or equals == std::string_view::npos)
+		{
+			return false;
+		}
+		const auto name = argument.substr(2, equals - 2);
+		const auto list = argument.substr(equals + 1);
+		if (name == "sprites")
+		{
+			return ParseList(list, options.spriteCounts, ParseCount);
+		}
+		if (name == "textures")
+		{
+			return ParseList(list, options.textureCounts, ParseCount) and
+				std::ranges::find(options.textureCounts, 0u) == options.textureCounts.end();
+		}
+		if (name == "rotated")
+		{
+			return ParseList(list, options.rotatedFractions, ParseFraction);
+		}
+		if (name == "sort")
+		{
+			return ParseList(list, options.sortModes, [](const std::string& text)
+							 { return ParseName<SpriteSortMode>(text, sortModeNames); });
+		}
+		if (name == "submission")
+		{
+			return ParseList(list, options.submissionModes, [](const std::string& text)
+							 { return ParseName<SpriteSubmissionMode>(text, submissionModeNames); });
+		}
+		if (name == "format")
+		{
+			return ParseList(list, options.vertexFormats, [](const std::string& text)
+							 { return ParseName<SpriteVertexFormat>(text, vertexFormatNames); });
+		}
+		if (name == "arrays")
+		{
+			return ParseList(list, options.textureArrays,
+							 [](const std::string& text) -> std::optional<bool>
+							 {
+								 if (text == "0" or text == "1")
+								 {
+									 return text == "1";
+								 }
+								 return std::nullopt;
+							 });
+		}
+		if (name == "api")
+		{
+			return ParseList(list, options.apis, [](const std::string& text)
+							 { return ParseName<SubmissionApi>(text, submissionApiNames); });
+		}
+		if (name == "frames")
+		{
+			auto frameCounts = std::vector<u32>{};
+			if (not ParseList(list, frameCounts, ParseCount) or frameCounts.size() != 1 or frameCounts[0] == 0)
+			{
+				return false;
+			}
+			options.frameCount = frameCounts[0];
+			return true;
+		}
+		return false;
+	}
+
+	// every combination of the option lists, the last list varies fastest
+	std::vector<Scenario> ExpandScenarios(const Options& options)
+	{
+		auto scenarios = std::vector<Scenario>{ Scenario{} };
+		const auto expand = [&](const auto& values, auto field)
+		{
+			auto expanded = std::vector<Scenario>{};
+			for (const auto& scenario : scenarios)
+			{
+				for (const auto value : values)
+				{
+					expanded.push_back(scenario);
+					expanded.back().*field = value;
+				}
+			}
+			scenarios = std::move(expanded);
+		};
+		expand(options.spriteCounts, &Scenario::spriteCount);
+		expand(options.textureCounts, &Scenario::textureCount);
+		expand(options.rotatedFractions, &Scenario::rotatedFraction);
+		expand(options.sortModes, &Scenario::sortMode);
+		expand(options.submissionModes, &Scenario::submissionMode);
+		expand(options.vertexFormats, &Scenario::vertexFormat);
+		expand(options.textureArrays, &Scenario::textureArrays);
+		expand(options.apis, &Scenario::api);
+		return scenarios;
+	}
+
+	std::vector<BenchSprite> GenerateSprites(const Scenario& scenario)
+	{
+		auto random = std::mt19937{ 42 };
+		auto texture = std::uniform_int_distribution<u32>{ 0, scenario.textureCount - 1 };
+		auto x = std::uniform_real_distribution<float>{ 0.0f, static_cast<float>(viewportWidth) };
+		auto y = std::uniform_real_distribution<float>{ 0.0f, static_cast<float>(viewportHeight) };
+		auto size = std::uniform_real_distribution<float>{ 8.0f, 64.0f };
+		auto unit = std::uniform_real_distribution<float>{ 0.0f, 1.0f };
+		auto channel = std::uniform_int_distribution<u32>{ 0, 255 };
+
+		auto sprites = std::vector<BenchSprite>(scenario.spriteCount);
+		for (auto& sprite : sprites)
+		{
+			const auto extent = vec2{ size(random), size(random) };
+			const auto isRotated = unit(random) < scenario.rotatedFraction;
+			sprite = BenchSprite{ .texture = texture(random),
+								  .destination = Rectangle{ vec2{ x(random), y(random) }, extent },
+								  .origin = extent * 0.5f,
+								  .rotation = isRotated ? unit(random) * 6.2831853f : 0.0f,
+								  .layer = unit(random),
+								  .color = Color{ static_cast<u8>(channel(random)), static_cast<u8>(channel(random)),
+												  static_cast<u8>(channel(random)), 255 } };
+		}
+		return sprites;
+	}
+
+	// the sprites of SubmissionApi::range, filled in once like a tile layer or particle system keeps them
+	std::vector<SpriteBatch::SpriteInfo> ResolveSprites(RenderContext& renderContext,
+														std::span<const Texture2DHandle> textures,
+														std::span<const BenchSprite> sprites)
+	{
+		auto spriteInfos = std::vector<SpriteBatch::SpriteInfo>{};
+		spriteInfos.reserve(sprites.size());
+		for (const auto& sprite : sprites)
+		{
+			const auto& texture = renderContext.GetSpriteTexture(textures[sprite.texture]);
+			spriteInfos.push_back(SpriteBatch::SpriteInfo{ .textureArray = texture.arrayNativeHandle,
+														   .textureLayer = texture.arrayLayer,
+														   .uvRect = vec4{ 0.0f, 0.0f, 1.0f, 1.0f },
+														   .destination = sprite.destination,
+														   .flip = FlipSprite::none,
+														   .origin = sprite.origin,
+														   .rotation = sprite.rotation,
+														   .layer = sprite.layer,
+														   .color = sprite.color,
+														   .blendMode = SpriteBlendMode::alpha });
+		}
+		return spriteInfos;
+	}
+
+	void DrawFrame(SpriteBatch& spriteBatch, const Scenario& scenario, std::span<const Texture2DHandle> textures,
+				   std::span<const BenchSprite> sprites, std::span<const SpriteBatch::SpriteInfo> spriteInfos)
+	{
+		const auto source = Rectangle{ vec2{ 0.0f, 0.0f }, vec2{ static_cast<float>(textureSize) } };
+		spriteBatch.Begin(mat3{ 1.0f }, nullptr, scenario.sortMode);
+		if (scenario.api == SubmissionApi::range)
+		{
+			spriteBatch.DrawRange(spriteInfos);
+		}
+		else
+		{
+			for (const auto& sprite : sprites)
+			{
+				spriteBatch.Draw(textures[sprite.texture], source, sprite.destination, sprite.color,
+								 FlipSprite::none, sprite.origin, sprite.rotation, sprite.layer);
+			}
+		}
+		spriteBatch.End();
+	}
+
+	u64 GetStreamedBytes(const SpriteBatch& spriteBatch)
+	{
+		return spriteBatch.vertexStream->GetAllocatedBytes() + spriteBatch.constantsStream->GetAllocatedBytes() +
+			spriteBatch.drawCommandStream->GetAllocatedBytes();
+	}
+
+	Result RunScenario(RenderContext& renderContext, SpriteBatch& spriteBatch, const Scenario& scenario,
+					   const u32 frameCount)
+	{
+		auto textures = std::vector<Texture2DHandle>{};
+		for (auto i = u32{ 0 }; i < scenario.textureCount; i++)
+		{
+			textures.push_back(renderContext.CreateTexture2D(
+				Texture2DDescriptor{ .extent = StaticExtent{ textureSize, textureSize },
+									 .format = TextureFormat::rgba8,
+									 .debugName = "bench_texture" }));
+		}
+		auto textureArrays = std::vector<Texture2DArrayHandle>{};
+		if (scenario.textureArrays)
+		{
+			const auto maxLayers = scenario.vertexFormat == SpriteVertexFormat::packed ?
+				SpriteBatch::maxPackedTextureLayers :
+				RenderContext::maxTextureArrayLayers;
+			textureArrays = renderContext.GroupIntoTextureArrays(textures, "bench_texture_array", maxLayers);
+			for (const auto textureArray : textureArrays)
+			{
+				renderContext.ReleaseGroupedTextureStorage(textureArray);
+			}
+		}
+		const auto sprites = GenerateSprites(scenario);
+		const auto spriteInfos = scenario.api == SubmissionApi::range ?
+			ResolveSprites(renderContext, textures, sprites) :
+			std::vector<SpriteBatch::SpriteInfo>{};
+		spriteBatch.SetSubmissionMode(scenario.submissionMode);
+		spriteBatch.SetVertexFormat(scenario.vertexFormat);
+
+		// the queues, the worker pool and the sort buffers reach their steady state size during the warm up
+		for (auto frame = u32{ 0 }; frame < warmUpFrameCount; frame++)
+		{
+			DrawFrame(spriteBatch, scenario, textures, sprites, spriteInfos);
+		}
+
+		const auto firstStreamedBytes = GetStreamedBytes(spriteBatch);
+		const auto firstAllocationCount = allocationCount.load();
+		const auto firstAllocatedBytes = allocatedBytes.load();
+		GetRecordingGlCounters() = RecordingGlCounters{};
+		const auto start = std::chrono::steady_clock::now();
+		for (auto frame = u32{ 0 }; frame < frameCount; frame++)
+		{
+			DrawFrame(spriteBatch, scenario, textures, sprites, spriteInfos);
+		}
+		const auto end = std::chrono::steady_clock::now();
+		const auto result = Result{ .seconds = std::chrono::duration<double>(end - start).count(),
+									.streamedBytes = GetStreamedBytes(spriteBatch) - firstStreamedBytes,
+									.allocations = allocationCount.load() - firstAllocationCount,
+									.allocatedBytes = allocatedBytes.load() - firstAllocatedBytes,
+									.glCounters = GetRecordingGlCounters() };
+
+		for (const auto textureArray : textureArrays)
+		{
+			renderContext.DestroyTexture2DArray(textureArray);
+		}
+		for (const auto texture : textures)
+		{
+			renderContext.DestroyTexture2D(texture);
+		}
+		return result;
+	}
+
+	void PrintResult(const Scenario& scenario, const u32 frameCount, const Result& result, const bool isFirst)
+	{
+		const auto spriteCount = static_cast<double>(scenario.spriteCount) * frameCount;
+		const auto frames = static_cast<double>(frameCount);
+		std::printf("%s\t\t{ \"sprites\": %u, \"textures\": %u, \"rotated\": %.2f, \"sort\": \"%s\", "
+					"\"submission\": \"%s\", \"format\": \"%s\", \"textureArrays\": %s, \"api\": \"%s\", "
+					"\"frames\": %u, \"spritesPerSecond\": %.0f, \"nsPerSprite\": %.3f, \"bytesPerSprite\": %.2f, "
+					"\"allocations\": %llu, \"allocationsPerFrame\": %.2f, \"allocatedBytesPerFrame\": %.0f, "
+					"\"drawCallsPerFrame\": %.2f, \"drawCommandsPerFrame\": %.2f, \"glCallsPerFrame\": %.2f }",
+					isFirst ? "" : ",\n", scenario.spriteCount, scenario.textureCount, scenario.rotatedFraction,
+					sortModeNames[static_cast<size_t>(scenario.sortMode)],
+					submissionModeNames[static_cast<size_t>(scenario.submissionMode)],
+					vertexFormatNames[static_cast<size_t>(scenario.vertexFormat)],
+					scenario.textureArrays ? "true" : "false", submissionApiNames[static_cast<size_t>(scenario.api)],
+					frameCount, spriteCount > 0.0 ? spriteCount / result.seconds : 0.0,
+					spriteCount > 0.0 ? result.seconds * 1.0e9 / spriteCount : 0.0,
+					spriteCount > 0.0 ? static_cast<double>(result.streamedBytes) / spriteCount : 0.0,
+					static_cast<unsigned long long>(result.allocations),
+					static_cast<double>(result.allocations) / frames,
+					static_cast<double>(result.allocatedBytes) / frames,
+					static_cast<double>(result.glCounters.drawCalls) / frames,
+					static_cast<double>(result.glCounters.drawCommands) / frames,
+					static_cast<double>(result.glCounters.calls) / frames);
+	}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	auto options = Options{};
+	for (auto i = 1; i < argc; i++)
+	{
+		if (not ParseOption(argv[i], options))
+		{
+			std::fprintf(stderr, "SpriteBatchBench: invalid option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	InstallRecordingGl();
+	auto renderContext = RenderContext{ viewportWidth, viewportHeight };
+	auto spriteBatch = SpriteBatch{ &renderContext };
+
+	std::printf("{\n\t\"scenarios\": [\n");
+	auto isFirst = true;
+	for (const auto& scenario : ExpandScenarios(options))
+	{
+		const auto result = RunScenario(renderContext, spriteBatch, scenario, options.frameCount);
+		PrintResult(scenario, options.frameCount, result, isFirst);
+		std::fflush(stdout);
+		isFirst = false;
+	}
+	std::printf("\n\t]\n}\n");
+	return 0;
+}
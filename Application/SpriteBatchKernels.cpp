@@ -0,0 +1,843 @@
+#include "SpriteBatchKernels.hpp"
+
+#include <algorithm>
+#include <array>
+#include <assert.h>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SPRITE_KERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define KERNEL_TARGET(instructionSet) __attribute__((target(instructionSet)))
+#else
+#define KERNEL_TARGET(instructionSet)
+#endif
+
+namespace
+{
+	constexpr auto verticesPerSprite = size_t{ SpriteBatch::verticesPerSprite };
+	constexpr auto flipHorizontalBit = u32{ 1 };
+	constexpr auto flipVerticalBit = u32{ 2 };
+
+	static_assert(static_cast<u32>(FlipSprite::horizontal) == flipHorizontalBit);
+	static_assert(static_cast<u32>(FlipSprite::vertical) == flipVerticalBit);
+	static_assert(static_cast<u32>(FlipSprite::horizontalAndVertical) == (flipHorizontalBit | flipVerticalBit));
+	static_assert(sizeof(SpriteBatch::SpriteQuadVertex) == 8 * sizeof(float));
+	static_assert(sizeof(SpriteBatch::SpriteRecord) == 48);
+	static_assert(sizeof(SpriteBatch::PackedSpriteQuadVertex) == 16);
+	// the kernels shift the additive flag down to the vertex additive bit
+	static_assert(SpriteBatch::vertexAdditiveBit == 1);
+
+	u16 PackUnorm16(const float value)
+	{
+		return static_cast<u16>(glm::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+	}
+
+	u32 PackedColor(const Color& color)
+	{
+		auto packed = u32{};
+		std::memcpy(&packed, &color, sizeof(packed));
+		return packed;
+	}
+
+	u32 FlipBits(const u32 flags)
+	{
+		return flags & (flipHorizontalBit | flipVerticalBit);
+	}
+
+	u32 TextureLayer(const u32 flags)
+	{
+		return flags >> SpriteBatch::textureLayerShift;
+	}
+
+	// value of the vertex texture layer attribute, see SpriteBatch::vertexLayerShift
+	u32 VertexLayer(const u32 flags)
+	{
+		return (TextureLayer(flags) << SpriteBatch::vertexLayerShift) |
+			((flags >> SpriteBatch::additiveFlagShift) & SpriteBatch::vertexAdditiveBit);
+	}
+
+	// the stream entries of one sprite
+	struct SpriteFields
+	{
+		vec4 destination;
+		vec4 uvRect;
+		vec4 transform;
+		Color color;
+		u32 flags;
+	};
+
+	SpriteFields LoadSprite(const SpriteBatch::SpriteStreams& sprites, const u32 index)
+	{
+		return SpriteFields{ .destination = sprites.destinations[index],
+							 .uvRect = sprites.uvRects[index],
+							 .transform = sprites.transforms[index],
+							 .color = sprites.colors[index],
+							 .flags = sprites.flags[index] };
+	}
+
+	/*
+		sin and cos in one go, range reduction to [-pi/4, pi/4] in three parts and minimax polynomials as in cephes'
+		sinf/cosf. The SIMD variants below execute exactly the same float operations lane wise, so rotated sprites come
+		out bit-identical in every kernel (as long as the compiler is not allowed to contract them into FMAs).
+	*/
+	constexpr auto fourOverPi = 1.27323954473516f;
+	constexpr auto reductionPart1 = 0.78515625f;
+	constexpr auto reductionPart2 = 2.4187564849853515625e-4f;
+	constexpr auto reductionPart3 = 3.77489497744594108e-8f;
+	constexpr auto cosCoefficient0 = 2.443315711809948e-5f;
+	constexpr auto cosCoefficient1 = -1.388731625493765e-3f;
+	constexpr auto cosCoefficient2 = 4.166664568298827e-2f;
+	constexpr auto sinCoefficient0 = -1.9515295891e-4f;
+	constexpr auto sinCoefficient1 = 8.3321608736e-3f;
+	constexpr auto sinCoefficient2 = -1.6666654611e-1f;
+	constexpr auto signBit = u32{ 0x80000000 };
+
+	/*
+		The octant conversion overflows i32 for NaN, infinity and |angle| beyond ~1.6e9, and the three part reduction
+		loses precision long before. Larger angles are reduced modulo 2 pi in double first, non finite ones draw the
+		sprite unrotated. All kernels test the same bound and reduce through this function.
+	*/
+	constexpr auto maxReducibleAngle = 8192.0f;
+	float ReduceLargeAngle(const float angle)
+	{
+		if (not std::isfinite(angle))
+		{
+			return 0.0f;
+		}
+		return static_cast<float>(std::fmod(static_cast<double>(angle), 2.0 * std::numbers::pi));
+	}
+
+	void SinCos(const float unreducedAngle, float& sine, float& cosine)
+	{
+		// written so NaN fails the test
+		const auto angle =
+			std::fabs(unreducedAngle) <= maxReducibleAngle ? unreducedAngle : ReduceLargeAngle(unreducedAngle);
+		auto angleBits = u32{};
+		std::memcpy(&angleBits, &angle, sizeof(angleBits));
+		const auto angleSign = angleBits & signBit;
+		const auto absoluteBits = angleBits & ~signBit;
+		auto x = float{};
+		std::memcpy(&x, &absoluteBits, sizeof(x));
+
+		// octant pair j / 2 of the angle, the reduced argument r lies within [-pi/4, pi/4]
+		const auto j = (static_cast<i32>(x * fourOverPi) + 1) & ~1;
+		const auto y = static_cast<float>(j);
+		const auto r = ((x - y * reductionPart1) - y * reductionPart2) - y * reductionPart3;
+		const auto z = r * r;
+
+		const auto polynomialCos =
+			((cosCoefficient0 * z + cosCoefficient1) * z + cosCoefficient2) * z * z - 0.5f * z + 1.0f;
+		const auto polynomialSin = ((sinCoefficient0 * z + sinCoefficient1) * z + sinCoefficient2) * z * r + r;
+
+		const auto swap = (j & 2) != 0;
+		auto sineBits = u32{};
+		auto cosineBits = u32{};
+		const auto sineValue = swap ? polynomialCos : polynomialSin;
+		const auto cosineValue = swap ? polynomialSin : polynomialCos;
+		std::memcpy(&sineBits, &sineValue, sizeof(sineBits));
+		std::memcpy(&cosineBits, &cosineValue, sizeof(cosineBits));
+		sineBits ^= angleSign ^ (static_cast<u32>(j & 4) << 29);
+		cosineBits ^= static_cast<u32>((j + 2) & 4) << 29;
+		std::memcpy(&sine, &sineBits, sizeof(sine));
+		std::memcpy(&cosine, &cosineBits, sizeof(cosine));
+	}
+
+	// corners in the order top right, top left, bottom right, bottom left
+	struct QuadCorners
+	{
+		std::array<vec2, verticesPerSprite> positions;
+		std::array<vec2, verticesPerSprite> uvs;
+	};
+
+	QuadCorners ComputeQuadCorners(const SpriteFields& sprite)
+	{
+		const auto position = vec2{ sprite.destination.x, sprite.destination.y };
+		// TODO: investigate
+		const auto extent = vec2{ sprite.destination.z, sprite.destination.w } + vec2{ 1.0f, 1.0f };
+
+		const auto uv0 = vec2{ sprite.uvRect.x, sprite.uvRect.y };
+		const auto uv1 = vec2{ sprite.uvRect.z, sprite.uvRect.w };
+
+		const auto flip = FlipBits(sprite.flags);
+		const auto flipX = (flip & flipHorizontalBit) != 0;
+		const auto flipY = (flip & flipVerticalBit) != 0;
+		const auto u0 = flipX ? uv1.x : uv0.x;
+		const auto u1 = flipX ? uv0.x : uv1.x;
+		const auto v0 = flipY ? uv1.y : uv0.y;
+		const auto v1 = flipY ? uv0.y : uv1.y;
+
+		const auto x1 = position.x + extent.x;
+		const auto y1 = position.y + extent.y;
+
+		auto corners = QuadCorners{ .positions = { vec2{ x1, position.y }, position, vec2{ x1, y1 },
+												   vec2{ position.x, y1 } },
+									.uvs = { vec2{ u1, v0 }, vec2{ u0, v0 }, vec2{ u1, v1 }, vec2{ u0, v1 } } };
+
+		const auto rotation = sprite.transform.z;
+		if (rotation != 0.0f)
+		{
+			// same corner construction as the vertex pulling shader: rotate around destination position + origin
+			auto sine = float{};
+			auto cosine = float{};
+			SinCos(rotation, sine, cosine);
+			const auto originX = sprite.transform.x;
+			const auto originY = sprite.transform.y;
+			const auto pivotX = position.x + originX;
+			const auto pivotY = position.y + originY;
+			const auto left = 0.0f - originX;
+			const auto right = extent.x - originX;
+			const auto top = 0.0f - originY;
+			const auto bottom = extent.y - originY;
+			const auto rotate = [&](const float localX, const float localY)
+			{
+				return vec2{ pivotX + (cosine * localX - sine * localY), pivotY + (sine * localX + cosine * localY) };
+			};
+			corners.positions = { rotate(right, top), rotate(left, top), rotate(right, bottom), rotate(left, bottom) };
+		}
+		return corners;
+	}
+
+	// Handles one sprite, used by the scalar kernel and for the tails of the SIMD kernels.
+	void ExpandQuad(const SpriteFields& sprite, SpriteBatch::SpriteQuadVertex* vertices)
+	{
+		const auto corners = ComputeQuadCorners(sprite);
+		const auto color = vec3{ sprite.color.r / 255.0f, sprite.color.g / 255.0f, sprite.color.b / 255.0f };
+		const auto layer = static_cast<float>(VertexLayer(sprite.flags));
+		for (auto corner = size_t{ 0 }; corner < verticesPerSprite; corner++)
+		{
+			vertices[corner] =
+				SpriteBatch::SpriteQuadVertex{ corners.positions[corner], corners.uvs[corner], color, layer };
+		}
+	}
+
+#ifdef SPRITE_KERNELS_X86
+	/*
+		Per sprite we hold p = (x0, y0, x1, y1) and t = (u0, v0, u1, v1). The four distinct quad corners are then
+		(x1, y0, u1, v0), (x0, y0, u0, v0), (x1, y1, u1, v1) and (x0, y1, u0, v1), which are a couple of shuffles away.
+		The trailing (r, g, b, texture layer) part is shared by all corners.
+	*/
+	KERNEL_TARGET("sse4.1")
+	inline void StoreQuadSse41(const __m128 p, const __m128 t, const __m128 color, float* out)
+	{
+		const auto topLeft = _mm_movelh_ps(p, t);
+		const auto bottomRight = _mm_movehl_ps(t, p);
+		const auto topRight = _mm_blend_ps(topLeft, bottomRight, 0b0101);
+		const auto bottomLeft = _mm_blend_ps(topLeft, bottomRight, 0b1010);
+
+		_mm_storeu_ps(out + 0, topRight);
+		_mm_storeu_ps(out + 4, color);
+		_mm_storeu_ps(out + 8, topLeft);
+		_mm_storeu_ps(out + 12, color);
+		_mm_storeu_ps(out + 16, bottomRight);
+		_mm_storeu_ps(out + 20, color);
+		_mm_storeu_ps(out + 24, bottomLeft);
+		_mm_storeu_ps(out + 28, color);
+	}
+
+	KERNEL_TARGET("avx2")
+	inline void StoreQuadAvx2(const __m128 p, const __m128 t, const __m128 color, float* out)
+	{
+		const auto topLeft = _mm_movelh_ps(p, t);
+		const auto bottomRight = _mm_movehl_ps(t, p);
+		const auto topRight = _mm_blend_ps(topLeft, bottomRight, 0b0101);
+		const auto bottomLeft = _mm_blend_ps(topLeft, bottomRight, 0b1010);
+
+		const auto vertex0 = _mm256_insertf128_ps(_mm256_castps128_ps256(topRight), color, 1);
+		const auto vertex1 = _mm256_insertf128_ps(_mm256_castps128_ps256(topLeft), color, 1);
+		const auto vertex2 = _mm256_insertf128_ps(_mm256_castps128_ps256(bottomRight), color, 1);
+		const auto vertex3 = _mm256_insertf128_ps(_mm256_castps128_ps256(bottomLeft), color, 1);
+
+		_mm256_storeu_ps(out + 0, vertex0);
+		_mm256_storeu_ps(out + 8, vertex1);
+		_mm256_storeu_ps(out + 16, vertex2);
+		_mm256_storeu_ps(out + 24, vertex3);
+	}
+
+	// per corner (top right, top left, bottom right, bottom left) rotated positions of every lane
+	template <size_t lanes>
+	using RotatedCorners = std::array<std::array<float, lanes>, verticesPerSprite>;
+
+	// overwrites the axis aligned positions of the lanes set in laneMask with their rotated corners
+	template <size_t lanes>
+	void ScatterRotatedCorners(const u32 laneMask, const RotatedCorners<lanes>& cornerX,
+							   const RotatedCorners<lanes>& cornerY, SpriteBatch::SpriteQuadVertex* vertices)
+	{
+		for (auto lane = size_t{ 0 }; lane < lanes; lane++)
+		{
+			if ((laneMask >> lane) & 1)
+			{
+				for (auto corner = size_t{ 0 }; corner < verticesPerSprite; corner++)
+				{
+					vertices[lane * verticesPerSprite + corner].position =
+						vec2{ cornerX[corner][lane], cornerY[corner][lane] };
+				}
+			}
+		}
+	}
+
+	// the rare lanes beyond maxReducibleAngle go through the scalar reduction
+	template <size_t lanes>
+	void ReduceLargeLanes(const u32 laneMask, std::array<float, lanes>& angles)
+	{
+		for (auto lane = size_t{ 0 }; lane < lanes; lane++)
+		{
+			if ((laneMask >> lane) & 1)
+			{
+				angles[lane] = ReduceLargeAngle(angles[lane]);
+			}
+		}
+	}
+
+	KERNEL_TARGET("sse4.1")
+	inline void SinCosSse41(const __m128 unreducedAngle, __m128& sine, __m128& cosine)
+	{
+		const auto signMask = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(signBit)));
+		auto angle = unreducedAngle;
+		// not less or equal is true for NaN as well
+		const auto largeLanes = static_cast<u32>(
+			_mm_movemask_ps(_mm_cmpnle_ps(_mm_andnot_ps(signMask, angle), _mm_set1_ps(maxReducibleAngle))));
+		if (largeLanes != 0)
+		{
+			auto lanes = std::array<float, 4>{};
+			_mm_storeu_ps(lanes.data(), angle);
+			ReduceLargeLanes(largeLanes, lanes);
+			angle = _mm_loadu_ps(lanes.data());
+		}
+		const auto two = _mm_set1_epi32(2);
+		const auto four = _mm_set1_epi32(4);
+		const auto angleSign = _mm_and_ps(angle, signMask);
+		const auto x = _mm_andnot_ps(signMask, angle);
+
+		auto j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(fourOverPi)));
+		j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+		const auto y = _mm_cvtepi32_ps(j);
+		const auto r = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(reductionPart1))),
+											 _mm_mul_ps(y, _mm_set1_ps(reductionPart2))),
+								  _mm_mul_ps(y, _mm_set1_ps(reductionPart3)));
+		const auto z = _mm_mul_ps(r, r);
+
+		auto polynomialCos = _mm_add_ps(
+			_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(cosCoefficient0), z), _mm_set1_ps(cosCoefficient1)), z),
+			_mm_set1_ps(cosCoefficient2));
+		polynomialCos = _mm_mul_ps(_mm_mul_ps(polynomialCos, z), z);
+		polynomialCos = _mm_add_ps(_mm_sub_ps(polynomialCos, _mm_mul_ps(_mm_set1_ps(0.5f), z)), _mm_set1_ps(1.0f));
+		auto polynomialSin = _mm_add_ps(
+			_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(sinCoefficient0), z), _mm_set1_ps(sinCoefficient1)), z),
+			_mm_set1_ps(sinCoefficient2));
+		polynomialSin = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(polynomialSin, z), r), r);
+
+		const auto swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, two), two));
+		const auto sineSign = _mm_xor_ps(angleSign, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, four), 29)));
+		const auto cosineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(j, two), four), 29));
+		sine = _mm_xor_ps(_mm_blendv_ps(polynomialSin, polynomialCos, swap), sineSign);
+		cosine = _mm_xor_ps(_mm_blendv_ps(polynomialCos, polynomialSin, swap), cosineSign);
+	}
+
+	KERNEL_TARGET("avx2")
+	inline void SinCosAvx2(const __m256 unreducedAngle, __m256& sine, __m256& cosine)
+	{
+		const auto signMask = _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(signBit)));
+		auto angle = unreducedAngle;
+		const auto largeLanes = static_cast<u32>(_mm256_movemask_ps(
+			_mm256_cmp_ps(_mm256_andnot_ps(signMask, angle), _mm256_set1_ps(maxReducibleAngle), _CMP_NLE_UQ)));
+		if (largeLanes != 0)
+		{
+			auto lanes = std::array<float, 8>{};
+			_mm256_storeu_ps(lanes.data(), angle);
+			ReduceLargeLanes(largeLanes, lanes);
+			angle = _mm256_loadu_ps(lanes.data());
+		}
+		const auto two = _mm256_set1_epi32(2);
+		const auto four = _mm256_set1_epi32(4);
+		const auto angleSign = _mm256_and_ps(angle, signMask);
+		const auto x = _mm256_andnot_ps(signMask, angle);
+
+		auto j = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(fourOverPi)));
+		j = _mm256_and_si256(_mm256_add_epi32(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+		const auto y = _mm256_cvtepi32_ps(j);
+		const auto r =
+			_mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(reductionPart1))),
+										_mm256_mul_ps(y, _mm256_set1_ps(reductionPart2))),
+						  _mm256_mul_ps(y, _mm256_set1_ps(reductionPart3)));
+		const auto z = _mm256_mul_ps(r, r);
+
+		auto polynomialCos = _mm256_add_ps(
+			_mm256_mul_ps(
+				_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(cosCoefficient0), z), _mm256_set1_ps(cosCoefficient1)), z),
+			_mm256_set1_ps(cosCoefficient2));
+		polynomialCos = _mm256_mul_ps(_mm256_mul_ps(polynomialCos, z), z);
+		polynomialCos =
+			_mm256_add_ps(_mm256_sub_ps(polynomialCos, _mm256_mul_ps(_mm256_set1_ps(0.5f), z)), _mm256_set1_ps(1.0f));
+		auto polynomialSin = _mm256_add_ps(
+			_mm256_mul_ps(
+				_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(sinCoefficient0), z), _mm256_set1_ps(sinCoefficient1)), z),
+			_mm256_set1_ps(sinCoefficient2));
+		polynomialSin = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(polynomialSin, z), r), r);
+
+		const auto swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, two), two));
+		const auto sineSign =
+			_mm256_xor_ps(angleSign, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, four), 29)));
+		const auto cosineSign =
+			_mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(j, two), four), 29));
+		sine = _mm256_xor_ps(_mm256_blendv_ps(polynomialSin, polynomialCos, swap), sineSign);
+		cosine = _mm256_xor_ps(_mm256_blendv_ps(polynomialCos, polynomialSin, swap), cosineSign);
+	}
+
+	// one register per component of four vec4 stream entries
+	KERNEL_TARGET("sse4.1")
+	inline void LoadTransposedSse41(const std::vector<vec4>& stream, const u32* index, __m128& c0, __m128& c1,
+									__m128& c2, __m128& c3)
+	{
+		c0 = _mm_loadu_ps(&stream[index[0]].x);
+		c1 = _mm_loadu_ps(&stream[index[1]].x);
+		c2 = _mm_loadu_ps(&stream[index[2]].x);
+		c3 = _mm_loadu_ps(&stream[index[3]].x);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	}
+
+	KERNEL_TARGET("sse4.1")
+	inline void RotateCornersSse41(const __m128 x0, const __m128 y0, const __m128 extentX, const __m128 extentY,
+								   const __m128 originX, const __m128 originY, const __m128 rotation,
+								   RotatedCorners<4>& cornerX, RotatedCorners<4>& cornerY)
+	{
+		auto sine = __m128{};
+		auto cosine = __m128{};
+		SinCosSse41(rotation, sine, cosine);
+		const auto zero = _mm_setzero_ps();
+		const auto pivotX = _mm_add_ps(x0, originX);
+		const auto pivotY = _mm_add_ps(y0, originY);
+		const auto left = _mm_sub_ps(zero, originX);
+		const auto right = _mm_sub_ps(extentX, originX);
+		const auto top = _mm_sub_ps(zero, originY);
+		const auto bottom = _mm_sub_ps(extentY, originY);
+		const auto localX = std::array{ right, left, right, left };
+		const auto localY = std::array{ top, top, bottom, bottom };
+		for (auto corner = size_t{ 0 }; corner < verticesPerSprite; corner++)
+		{
+			const auto x =
+				_mm_add_ps(pivotX, _mm_sub_ps(_mm_mul_ps(cosine, localX[corner]), _mm_mul_ps(sine, localY[corner])));
+			const auto y =
+				_mm_add_ps(pivotY, _mm_add_ps(_mm_mul_ps(sine, localX[corner]), _mm_mul_ps(cosine, localY[corner])));
+			_mm_storeu_ps(cornerX[corner].data(), x);
+			_mm_storeu_ps(cornerY[corner].data(), y);
+		}
+	}
+
+	KERNEL_TARGET("avx2")
+	inline void RotateCornersAvx2(const __m256 x0, const __m256 y0, const __m256 extentX, const __m256 extentY,
+								  const __m256 originX, const __m256 originY, const __m256 rotation,
+								  RotatedCorners<8>& cornerX, RotatedCorners<8>& cornerY)
+	{
+		auto sine = __m256{};
+		auto cosine = __m256{};
+		SinCosAvx2(rotation, sine, cosine);
+		const auto zero = _mm256_setzero_ps();
+		const auto pivotX = _mm256_add_ps(x0, originX);
+		const auto pivotY = _mm256_add_ps(y0, originY);
+		const auto left = _mm256_sub_ps(zero, originX);
+		const auto right = _mm256_sub_ps(extentX, originX);
+		const auto top = _mm256_sub_ps(zero, originY);
+		const auto bottom = _mm256_sub_ps(extentY, originY);
+		const auto localX = std::array{ right, left, right, left };
+		const auto localY = std::array{ top, top, bottom, bottom };
+		for (auto corner = size_t{ 0 }; corner < verticesPerSprite; corner++)
+		{
+			const auto x = _mm256_add_ps(
+				pivotX, _mm256_sub_ps(_mm256_mul_ps(cosine, localX[corner]), _mm256_mul_ps(sine, localY[corner])));
+			const auto y = _mm256_add_ps(
+				pivotY, _mm256_add_ps(_mm256_mul_ps(sine, localX[corner]), _mm256_mul_ps(cosine, localY[corner])));
+			_mm256_storeu_ps(cornerX[corner].data(), x);
+			_mm256_storeu_ps(cornerY[corner].data(), y);
+		}
+	}
+#endif
+} // namespace
+
+namespace kernels
+{
+	void ExpandQuadsScalar(const SpriteBatch::SpriteStreams& sprites, std::span<const u32> indices,
+						   std::span<SpriteBatch::SpriteQuadVertex> vertices)
+	{
+		assert(vertices.size() >= indices.size() * verticesPerSprite);
+		for (auto i = size_t{ 0 }; i < indices.size(); i++)
+		{
+			ExpandQuad(LoadSprite(sprites, indices[i]), vertices.data() + i * verticesPerSprite);
+		}
+	}
+
+	void ExpandPackedQuads(const SpriteBatch::SpriteStreams& sprites, std::span<const u32> indices,
+						   std::span<SpriteBatch::PackedSpriteQuadVertex> vertices)
+	{
+		assert(vertices.size() >= indices.size() * verticesPerSprite);
+		for (auto i = size_t{ 0 }; i < indices.size(); i++)
+		{
+			const auto sprite = LoadSprite(sprites, indices[i]);
+			assert(TextureLayer(sprite.flags) < SpriteBatch::maxPackedTextureLayers);
+			const auto corners = ComputeQuadCorners(sprite);
+			const auto colorAndTextureLayer = std::array{ sprite.color.r, sprite.color.g, sprite.color.b,
+														  static_cast<u8>(VertexLayer(sprite.flags)) };
+			for (auto corner = size_t{ 0 }; corner < verticesPerSprite; corner++)
+			{
+				vertices[i * verticesPerSprite + corner] = SpriteBatch::PackedSpriteQuadVertex{
+					.position = corners.positions[corner],
+					.uv = { PackUnorm16(corners.uvs[corner].x), PackUnorm16(corners.uvs[corner].y) },
+					.colorAndTextureLayer = colorAndTextureLayer
+				};
+			}
+		}
+	}
+
+	void PackSpriteRecords(const SpriteBatch::SpriteStreams& sprites, std::span<const u32> indices,
+						   std::span<SpriteBatch::SpriteRecord> records)
+	{
+		assert(records.size() >= indices.size());
+		for (auto i = size_t{ 0 }; i < indices.size(); i++)
+		{
+			const auto sprite = LoadSprite(sprites, indices[i]);
+			records[i] = SpriteBatch::SpriteRecord{
+				.destination = sprite.destination,
+				.uvRect = { PackUnorm16(sprite.uvRect.x), PackUnorm16(sprite.uvRect.y), PackUnorm16(sprite.uvRect.z),
+							PackUnorm16(sprite.uvRect.w) },
+				.color = PackedColor(sprite.color),
+				.flags = sprite.flags,
+				.origin = vec2{ sprite.transform.x, sprite.transform.y },
+				.rotation = sprite.transform.z,
+				.layer = sprite.transform.w
+			};
+		}
+	}
+
+	void RadixSortIndices(std::span<const u64> keys, std::span<u32> indices, std::span<u32> scratch,
+						  const u32 firstDigit)
+	{
+		assert(scratch.size() >= indices.size());
+		constexpr auto digitBits = u32{ 8 };
+		constexpr auto digitCount = u32{ 64 / digitBits };
+		constexpr auto bucketCount = size_t{ 1 } << digitBits;
+
+		// all histograms are built in one sweep over the keys
+		auto histograms = std::array<std::array<u32, bucketCount>, digitCount>{};
+		for (const auto index : indices)
+		{
+			const auto key = keys[index];
+			for (auto digit = firstDigit; digit < digitCount; digit++)
+			{
+				histograms[digit][(key >> (digit * digitBits)) & (bucketCount - 1)]++;
+			}
+		}
+
+		auto source = indices;
+		auto destination = scratch.first(indices.size());
+		for (auto digit = firstDigit; digit < digitCount; digit++)
+		{
+			auto& histogram = histograms[digit];
+			const auto firstKey = indices.empty() ? u64{ 0 } : keys[source[0]];
+			if (histogram[(firstKey >> (digit * digitBits)) & (bucketCount - 1)] == indices.size())
+			{
+				continue;
+			}
+
+			auto offset = u32{ 0 };
+			for (auto& bucket : histogram)
+			{
+				const auto count = bucket;
+				bucket = offset;
+				offset += count;
+			}
+			for (const auto index : source)
+			{
+				const auto bucket = (keys[index] >> (digit * digitBits)) & (bucketCount - 1);
+				destination[histogram[bucket]++] = index;
+			}
+			std::swap(source, destination);
+		}
+
+		if (source.data() != indices.data())
+		{
+			std::copy(source.begin(), source.end(), indices.begin());
+		}
+	}
+
+#ifdef SPRITE_KERNELS_X86
+	KERNEL_TARGET("sse4.1")
+	void ExpandQuadsSse41(const SpriteBatch::SpriteStreams& sprites, std::span<const u32> indices,
+						  std::span<SpriteBatch::SpriteQuadVertex> vertices)
+	{
+		assert(vertices.size() >= indices.size() * verticesPerSprite);
+		constexpr auto lanes = size_t{ 4 };
+
+		const auto one = _mm_set1_ps(1.0f);
+		const auto colorScale = _mm_set1_ps(255.0f);
+		const auto byteMask = _mm_set1_epi32(0xff);
+		const auto horizontalBit = _mm_set1_epi32(flipHorizontalBit);
+		const auto verticalBit = _mm_set1_epi32(flipVerticalBit);
+		const auto vertexAdditiveBit = _mm_set1_epi32(SpriteBatch::vertexAdditiveBit);
+
+		auto i = size_t{ 0 };
+		for (; i + lanes <= indices.size(); i += lanes)
+		{
+			const auto* index = indices.data() + i;
+			auto x0 = __m128{};
+			auto y0 = __m128{};
+			auto width = __m128{};
+			auto height = __m128{};
+			LoadTransposedSse41(sprites.destinations, index, x0, y0, width, height);
+			const auto extentX = _mm_add_ps(width, one);
+			const auto extentY = _mm_add_ps(height, one);
+			auto x1 = _mm_add_ps(x0, extentX);
+			auto y1 = _mm_add_ps(y0, extentY);
+
+			// rotated sprites take the same axis aligned path first, their positions are replaced afterwards
+			auto originX = __m128{};
+			auto originY = __m128{};
+			auto rotation = __m128{};
+			auto sortLayer = __m128{};
+			LoadTransposedSse41(sprites.transforms, index, originX, originY, rotation, sortLayer);
+			const auto rotatedLanes = static_cast<u32>(_mm_movemask_ps(_mm_cmpneq_ps(rotation, _mm_setzero_ps())));
+			auto cornerX = RotatedCorners<lanes>{};
+			auto cornerY = RotatedCorners<lanes>{};
+			if (rotatedLanes != 0)
+			{
+				RotateCornersSse41(x0, y0, extentX, extentY, originX, originY, rotation, cornerX, cornerY);
+			}
+
+			auto uvLeft = __m128{};
+			auto uvTop = __m128{};
+			auto uvRight = __m128{};
+			auto uvBottom = __m128{};
+			LoadTransposedSse41(sprites.uvRects, index, uvLeft, uvTop, uvRight, uvBottom);
+
+			const auto flags = _mm_setr_epi32(
+				static_cast<int>(sprites.flags[index[0]]), static_cast<int>(sprites.flags[index[1]]),
+				static_cast<int>(sprites.flags[index[2]]), static_cast<int>(sprites.flags[index[3]]));
+			const auto flipX = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(flags, horizontalBit), horizontalBit));
+			const auto flipY = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(flags, verticalBit), verticalBit));
+			auto u0 = _mm_blendv_ps(uvLeft, uvRight, flipX);
+			auto u1 = _mm_blendv_ps(uvRight, uvLeft, flipX);
+			auto v0 = _mm_blendv_ps(uvTop, uvBottom, flipY);
+			auto v1 = _mm_blendv_ps(uvBottom, uvTop, flipY);
+
+			const auto packedColor = _mm_setr_epi32(static_cast<int>(PackedColor(sprites.colors[index[0]])),
+													static_cast<int>(PackedColor(sprites.colors[index[1]])),
+													static_cast<int>(PackedColor(sprites.colors[index[2]])),
+													static_cast<int>(PackedColor(sprites.colors[index[3]])));
+			auto r = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(packedColor, byteMask)), colorScale);
+			auto g = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packedColor, 8), byteMask)), colorScale);
+			auto b = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packedColor, 16), byteMask)), colorScale);
+			auto layer = _mm_cvtepi32_ps(_mm_or_si128(
+				_mm_slli_epi32(_mm_srli_epi32(flags, SpriteBatch::textureLayerShift), SpriteBatch::vertexLayerShift),
+				_mm_and_si128(_mm_srli_epi32(flags, SpriteBatch::additiveFlagShift), vertexAdditiveBit)));
+
+			_MM_TRANSPOSE4_PS(x0, y0, x1, y1);
+			_MM_TRANSPOSE4_PS(u0, v0, u1, v1);
+			_MM_TRANSPOSE4_PS(r, g, b, layer);
+
+			auto* out = reinterpret_cast<float*>(vertices.data() + i * verticesPerSprite);
+			constexpr auto floatsPerSprite = verticesPerSprite * 8;
+			StoreQuadSse41(x0, u0, r, out + 0 * floatsPerSprite);
+			StoreQuadSse41(y0, v0, g, out + 1 * floatsPerSprite);
+			StoreQuadSse41(x1, u1, b, out + 2 * floatsPerSprite);
+			StoreQuadSse41(y1, v1, layer, out + 3 * floatsPerSprite);
+
+			if (rotatedLanes != 0)
+			{
+				ScatterRotatedCorners(rotatedLanes, cornerX, cornerY, vertices.data() + i * verticesPerSprite);
+			}
+		}
+
+		for (; i < indices.size(); i++)
+		{
+			ExpandQuad(LoadSprite(sprites, indices[i]), vertices.data() + i * verticesPerSprite);
+		}
+	}
+
+	KERNEL_TARGET("avx2")
+	void ExpandQuadsAvx2(const SpriteBatch::SpriteStreams& sprites, std::span<const u32> indices,
+						 std::span<SpriteBatch::SpriteQuadVertex> vertices)
+	{
+		assert(vertices.size() >= indices.size() * verticesPerSprite);
+		constexpr auto lanes = size_t{ 8 };
+
+		const auto one = _mm256_set1_ps(1.0f);
+		const auto colorScale = _mm256_set1_ps(255.0f);
+		const auto byteMask = _mm256_set1_epi32(0xff);
+		const auto horizontalBit = _mm256_set1_epi32(flipHorizontalBit);
+		const auto verticalBit = _mm256_set1_epi32(flipVerticalBit);
+		const auto vertexAdditiveBit = _mm256_set1_epi32(SpriteBatch::vertexAdditiveBit);
+
+		auto i = size_t{ 0 };
+		for (; i + lanes <= indices.size(); i += lanes)
+		{
+			// hardware gathers straight from the streams, the vec4 streams hold four floats per sprite
+			const auto index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices.data() + i));
+			const auto vectorIndex = _mm256_slli_epi32(index, 2);
+#define GATHER(stream, component)                                                                                      \
+	_mm256_i32gather_ps(reinterpret_cast<const float*>(sprites.stream.data()) + component, vectorIndex, 4)
+#define GATHER_INT(stream) _mm256_i32gather_epi32(reinterpret_cast<const int*>(sprites.stream.data()), index, 4)
+
+			const auto x0 = GATHER(destinations, 0);
+			const auto y0 = GATHER(destinations, 1);
+			const auto extentX = _mm256_add_ps(GATHER(destinations, 2), one);
+			const auto extentY = _mm256_add_ps(GATHER(destinations, 3), one);
+			const auto x1 = _mm256_add_ps(x0, extentX);
+			const auto y1 = _mm256_add_ps(y0, extentY);
+
+			// rotated sprites take the same axis aligned path first, their positions are replaced afterwards
+			const auto rotation = GATHER(transforms, 2);
+			const auto rotatedLanes = static_cast<u32>(
+				_mm256_movemask_ps(_mm256_cmp_ps(rotation, _mm256_setzero_ps(), _CMP_NEQ_UQ)));
+			auto cornerX = RotatedCorners<lanes>{};
+			auto cornerY = RotatedCorners<lanes>{};
+			if (rotatedLanes != 0)
+			{
+				RotateCornersAvx2(x0, y0, extentX, extentY, GATHER(transforms, 0), GATHER(transforms, 1), rotation,
+								  cornerX, cornerY);
+			}
+
+			const auto uvLeft = GATHER(uvRects, 0);
+			const auto uvTop = GATHER(uvRects, 1);
+			const auto uvRight = GATHER(uvRects, 2);
+			const auto uvBottom = GATHER(uvRects, 3);
+
+			const auto flags = GATHER_INT(flags);
+			const auto flipX =
+				_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(flags, horizontalBit), horizontalBit));
+			const auto flipY =
+				_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(flags, verticalBit), verticalBit));
+			const auto u0 = _mm256_blendv_ps(uvLeft, uvRight, flipX);
+			const auto u1 = _mm256_blendv_ps(uvRight, uvLeft, flipX);
+			const auto v0 = _mm256_blendv_ps(uvTop, uvBottom, flipY);
+			const auto v1 = _mm256_blendv_ps(uvBottom, uvTop, flipY);
+
+			const auto packedColor = GATHER_INT(colors);
+			const auto r = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_and_si256(packedColor, byteMask)), colorScale);
+			const auto g = _mm256_div_ps(
+				_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(packedColor, 8), byteMask)), colorScale);
+			const auto b = _mm256_div_ps(
+				_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(packedColor, 16), byteMask)), colorScale);
+			const auto layer = _mm256_cvtepi32_ps(
+				_mm256_or_si256(_mm256_slli_epi32(_mm256_srli_epi32(flags, SpriteBatch::textureLayerShift),
+												  SpriteBatch::vertexLayerShift),
+								_mm256_and_si256(_mm256_srli_epi32(flags, SpriteBatch::additiveFlagShift),
+												 vertexAdditiveBit)));
+#undef GATHER_INT
+#undef GATHER
+
+			auto* out = reinterpret_cast<float*>(vertices.data() + i * verticesPerSprite);
+			constexpr auto floatsPerSprite = verticesPerSprite * 8;
+
+			// Both 128 bit halves are transposed independently, the low half holds sprites 0..3, the high one 4..7.
+			for (auto half = 0; half < 2; half++)
+			{
+				auto px0 = half ? _mm256_extractf128_ps(x0, 1) : _mm256_castps256_ps128(x0);
+				auto py0 = half ? _mm256_extractf128_ps(y0, 1) : _mm256_castps256_ps128(y0);
+				auto px1 = half ? _mm256_extractf128_ps(x1, 1) : _mm256_castps256_ps128(x1);
+				auto py1 = half ? _mm256_extractf128_ps(y1, 1) : _mm256_castps256_ps128(y1);
+				auto tu0 = half ? _mm256_extractf128_ps(u0, 1) : _mm256_castps256_ps128(u0);
+				auto tv0 = half ? _mm256_extractf128_ps(v0, 1) : _mm256_castps256_ps128(v0);
+				auto tu1 = half ? _mm256_extractf128_ps(u1, 1) : _mm256_castps256_ps128(u1);
+				auto tv1 = half ? _mm256_extractf128_ps(v1, 1) : _mm256_castps256_ps128(v1);
+				auto cr = half ? _mm256_extractf128_ps(r, 1) : _mm256_castps256_ps128(r);
+				auto cg = half ? _mm256_extractf128_ps(g, 1) : _mm256_castps256_ps128(g);
+				auto cb = half ? _mm256_extractf128_ps(b, 1) : _mm256_castps256_ps128(b);
+				auto cl = half ? _mm256_extractf128_ps(layer, 1) : _mm256_castps256_ps128(layer);
+
+				_MM_TRANSPOSE4_PS(px0, py0, px1, py1);
+				_MM_TRANSPOSE4_PS(tu0, tv0, tu1, tv1);
+				_MM_TRANSPOSE4_PS(cr, cg, cb, cl);
+
+				auto* halfOut = out + half * 4 * floatsPerSprite;
+				StoreQuadAvx2(px0, tu0, cr, halfOut + 0 * floatsPerSprite);
+				StoreQuadAvx2(py0, tv0, cg, halfOut + 1 * floatsPerSprite);
+				StoreQuadAvx2(px1, tu1, cb, halfOut + 2 * floatsPerSprite);
+				StoreQuadAvx2(py1, tv1, cl, halfOut + 3 * floatsPerSprite);
+			}
+
+			if (rotatedLanes != 0)
+			{
+				ScatterRotatedCorners(rotatedLanes, cornerX, cornerY, vertices.data() + i * verticesPerSprite);
+			}
+		}
+
+		ExpandQuadsSse41(sprites, indices.subspan(i), vertices.subspan(i * verticesPerSprite));
+	}
+
+	InstructionSet DetectInstructionSet()
+	{
+#if defined(_MSC_VER)
+		auto info = std::array<int, 4>{};
+		__cpuid(info.data(), 0);
+		const auto maxLeaf = info[0];
+		__cpuid(info.data(), 1);
+		const auto hasSse41 = (info[2] & (1 << 19)) != 0;
+		const auto hasOsxsave = (info[2] & (1 << 27)) != 0;
+		const auto hasAvx = (info[2] & (1 << 28)) != 0;
+		auto hasAvx2 = false;
+		if (maxLeaf >= 7 and hasOsxsave and hasAvx)
+		{
+			const auto osSavesYmm = (_xgetbv(0) & 0x6) == 0x6;
+			__cpuidex(info.data(), 7, 0);
+			hasAvx2 = osSavesYmm and (info[1] & (1 << 5)) != 0;
+		}
+#else
+		__builtin_cpu_init();
+		const auto hasSse41 = __builtin_cpu_supports("sse4.1") != 0;
+		const auto hasAvx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+		if (hasAvx2)
+		{
+			return InstructionSet::avx2;
+		}
+		if (hasSse41)
+		{
+			return InstructionSet::sse41;
+		}
+		return InstructionSet::scalar;
+	}
+
+	ExpandQuadsFunction SelectExpandQuads(const InstructionSet instructionSet)
+	{
+		switch (instructionSet)
+		{
+		case InstructionSet::avx2:
+			return &ExpandQuadsAvx2;
+		case InstructionSet::sse41:
+			return &ExpandQuadsSse41;
+		case InstructionSet::scalar:
+			return &ExpandQuadsScalar;
+		}
+		return &ExpandQuadsScalar;
+	}
+#else
+	void ExpandQuadsSse41(const SpriteBatch::SpriteStreams& sprites, std::span<const u32> indices,
+						  std::span<SpriteBatch::SpriteQuadVertex> vertices)
+	{
+		ExpandQuadsScalar(sprites, indices, vertices);
+	}
+
+	void ExpandQuadsAvx2(const SpriteBatch::SpriteStreams& sprites, std::span<const u32> indices,
+						 std::span<SpriteBatch::SpriteQuadVertex> vertices)
+	{
+		ExpandQuadsScalar(sprites, indices, vertices);
+	}
+
+	InstructionSet DetectInstructionSet()
+	{
+		return InstructionSet::scalar;
+	}
+
+	ExpandQuadsFunction SelectExpandQuads(const InstructionSet)
+	{
+		return &ExpandQuadsScalar;
+	}
+#endif
+} // namespace kernels
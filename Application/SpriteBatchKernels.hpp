@@ -0,0 +1,53 @@
+#pragma once
+
+#include <span>
+
+#include "Common.hpp"
+#include "SpriteBatch.hpp"
+
+namespace kernels
+{
+	enum class InstructionSet
+	{
+		scalar,
+		sse41,
+		avx2
+	};
+
+	/*
+		Expands the queued sprites indices[i] of a run that shares one texture into four SpriteQuadVertex entries (top
+		right, top left, bottom right, bottom left). The output span has to be presized to indices.size() * 4. The
+		sprites are read from the per field streams, so the sort only permutes 32 bit indices and the SIMD variants
+		load one field of several sprites at once. All variants produce bit-identical vertices, the SIMD ones just
+		process four (SSE4.1) or eight (AVX2) sprites per iteration and resolve the flip with masks instead of branches.
+	*/
+	using ExpandQuadsFunction = SpriteBatch::ExpandQuadsFunction;
+
+	void ExpandQuadsScalar(const SpriteBatch::SpriteStreams& sprites, std::span<const u32> indices,
+						   std::span<SpriteBatch::SpriteQuadVertex> vertices);
+	void ExpandQuadsSse41(const SpriteBatch::SpriteStreams& sprites, std::span<const u32> indices,
+						  std::span<SpriteBatch::SpriteQuadVertex> vertices);
+	void ExpandQuadsAvx2(const SpriteBatch::SpriteStreams& sprites, std::span<const u32> indices,
+						 std::span<SpriteBatch::SpriteQuadVertex> vertices);
+
+	// Same corners as ExpandQuadsScalar in the 16 byte SpriteVertexFormat::packed layout, texture layers must fit
+	// 8 bits.
+	void ExpandPackedQuads(const SpriteBatch::SpriteStreams& sprites, std::span<const u32> indices,
+						   std::span<SpriteBatch::PackedSpriteQuadVertex> vertices);
+
+	// Fills the compact per sprite records of the vertex pulling mode, the output span needs indices.size() entries.
+	void PackSpriteRecords(const SpriteBatch::SpriteStreams& sprites, std::span<const u32> indices,
+						   std::span<SpriteBatch::SpriteRecord> records);
+
+	/*
+		Stable LSD radix sort of the index array by keys[index], one 8 bit digit per pass, starting at firstDigit.
+		Digits below firstDigit are not looked at, which is fine whenever the indices already come ordered by them,
+		e.g. the sequence number half of sprite sort keys while the indices are still in submission order. Passes in
+		which every key has the same digit are skipped. scratch needs indices.size() entries.
+	*/
+	void RadixSortIndices(std::span<const u64> keys, std::span<u32> indices, std::span<u32> scratch,
+						  const u32 firstDigit = 0);
+
+	InstructionSet DetectInstructionSet();
+	ExpandQuadsFunction SelectExpandQuads(const InstructionSet instructionSet);
+} // namespace kernels
@@ -0,0 +1,21 @@
+#include "SpriteRecorder.hpp"
+
+void SpriteRecorder::Draw(const SpriteRegion& region, const vec2& position, const Color& color)
+{
+	Draw(region, Rectangle{ position, region.extent }, color);
+}
+
+void SpriteRecorder::Draw(const SpriteRegion& region, const Rectangle& destination, const Color& color,
+						  const FlipSprite flip, const vec2& origin, float rotation, float layer)
+{
+	sprites.push_back(SpriteBatch::SpriteInfo{ .textureArray = region.textureArray,
+											   .textureLayer = region.textureLayer,
+											   .uvRect = region.uvRect,
+											   .destination = destination,
+											   .flip = flip,
+											   .origin = origin,
+											   .rotation = rotation,
+											   .layer = layer,
+											   .color = color,
+											   .blendMode = blendMode });
+}
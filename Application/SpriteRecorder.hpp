@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+#include "Color.hpp"
+#include "Common.hpp"
+#include "SpriteBatch.hpp"
+#include "SpriteRegion.hpp"
+
+/*
+	Sprite list owned by a single thread. Game code can fill one recorder per worker without any synchronization,
+	as regions are drawn without looking anything up in the RenderContext. SpriteBatch::Add() hands a recorder to the
+	batch, End() merges all added recorders in the order they were added and clears them for the next frame.
+*/
+struct SpriteRecorder
+{
+	void Draw(const SpriteRegion& region, const vec2& position, const Color& color = Colors::White);
+	void Draw(const SpriteRegion& region, const Rectangle& destination, const Color& color = Colors::White,
+			  const FlipSprite flip = FlipSprite::none, const vec2& origin = vec2{ 0.0f, 0.0f }, float rotation = 0.0f,
+			  float layer = 0.0f);
+
+	// blend mode of the following Draw() calls, kept across frames
+	void SetBlendMode(const SpriteBlendMode mode)
+	{
+		blendMode = mode;
+	}
+
+	void Reserve(const u32 spriteCount)
+	{
+		sprites.reserve(spriteCount);
+	}
+	void Clear()
+	{
+		sprites.clear();
+	}
+
+	std::vector<SpriteBatch::SpriteInfo> sprites;
+	SpriteBlendMode blendMode{ SpriteBlendMode::alpha };
+};
@@ -0,0 +1,32 @@
+#include "SpriteRegion.hpp"
+
+#include "Animation.hpp"
+#include "RenderContext.hpp"
+
+SpriteRegion CreateSpriteRegion(RenderContext& context, const Texture2DHandle texture, const Rectangle& source)
+{
+	const auto& textureData = context.GetSpriteTexture(texture);
+	const auto textureExtent = vec2{ textureData.width, textureData.height };
+	return SpriteRegion{ .texture = texture,
+						 .textureArray = textureData.arrayNativeHandle,
+						 .textureLayer = textureData.arrayLayer,
+						 .uvRect = vec4{ source.position / textureExtent,
+										 (source.position + source.extent) / textureExtent },
+						 .extent = source.extent };
+}
+
+SpriteRegion CreateSpriteRegion(RenderContext& context, const Texture2DHandle texture, const AnimationFrame& frame)
+{
+	return CreateSpriteRegion(context, texture, frame.sourceSprite);
+}
+
+SpriteRegion CreateTileRegion(RenderContext& context, const Texture2DHandle tileset, const u32 localTileId,
+							  const vec2& tileExtent)
+{
+	const auto& textureData = context.Get(tileset);
+	const auto columns = static_cast<u32>(textureData.width / tileExtent.x);
+	const auto column = localTileId % columns;
+	const auto row = localTileId / columns;
+	const auto source = Rectangle{ vec2{ column, row } * tileExtent, tileExtent };
+	return CreateSpriteRegion(context, tileset, source);
+}
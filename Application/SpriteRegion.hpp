@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Common.hpp"
+#include "RenderResources.hpp"
+
+struct RenderContext;
+struct AnimationFrame;
+
+/*
+	Part of a texture prepared for SpriteBatch::Draw(): the texture array binding is resolved and the source rectangle
+	is normalized once, so drawing a region needs neither a texture lookup nor a division.
+	Regions capture the array binding of their texture, create them after RenderContext::GroupIntoTextureArrays()
+	and recreate them when the texture is regrouped.
+*/
+struct SpriteRegion
+{
+	Texture2DHandle texture;
+	GLuint textureArray;
+	u32 textureLayer;
+	vec4 uvRect; // normalized u0, v0, u1, v1
+	vec2 extent; // source size in pixels
+};
+
+SpriteRegion CreateSpriteRegion(RenderContext& context, const Texture2DHandle texture, const Rectangle& source);
+SpriteRegion CreateSpriteRegion(RenderContext& context, const Texture2DHandle texture, const AnimationFrame& frame);
+// tiles are numbered row by row from the top left corner of the tileset image, starting at 0
+SpriteRegion CreateTileRegion(RenderContext& context, const Texture2DHandle tileset, const u32 localTileId,
+							  const vec2& tileExtent);
@@ -0,0 +1,13 @@
+#include "StaticSpriteCache.hpp"
+
+StaticSpriteCache::~StaticSpriteCache()
+{
+	if (stateCache)
+	{
+		stateCache->Invalidate();
+	}
+	glDeleteVertexArrays(1, &vertexArrayObject);
+	glDeleteBuffers(1, &drawCommandBuffer);
+	glDeleteBuffers(1, &layerBuffer);
+	glDeleteBuffers(1, &vertexBuffer);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include "Common.hpp"
+#include "OpenGlStateCache.hpp"
+#include "SpriteBatch.hpp"
+
+/*
+	Sprites recorded once by SpriteBatch::BeginRecording()/EndRecording(), e.g. the tile layers of a map. The
+	vertices or sprite records and the indirect draw commands live in immutable buffers, so drawing the cache has no
+	per sprite cpu work and uploads nothing.
+*/
+struct StaticSpriteCache
+{
+	StaticSpriteCache() = default;
+	~StaticSpriteCache();
+
+	StaticSpriteCache(const StaticSpriteCache&) = delete;
+	StaticSpriteCache& operator=(const StaticSpriteCache&) = delete;
+
+	u32 GetSpriteCount() const
+	{
+		return spriteCount;
+	}
+
+	SpriteSubmissionMode submissionMode{ SpriteSubmissionMode::cpuExpansion };
+	SpriteVertexFormat vertexFormat{ SpriteVertexFormat::float32 };
+	bool premultipliedAlpha{ false };
+	bool depthTesting{ false };
+	u32 spriteCount{ 0 };
+	// the draw commands in groups of one multi draw each
+	std::vector<SpriteBatch::DrawGroup> drawGroups;
+	u32 batchCount{ 0 };
+
+	// openGL specific fields
+	GLuint vertexBuffer{ 0 };
+	GLuint drawCommandBuffer{ 0 };
+	// sprite layers of the cpu expanded quads with depth testing
+	GLuint layerBuffer{ 0 };
+	// vertex layout of the cpu expanded vertices, vertex pulling uses the index only vertex array of the batch
+	GLuint vertexArrayObject{ 0 };
+	// forgets the bindings of the deleted objects on destruction
+	OpenGlStateCache* stateCache{ nullptr };
+};
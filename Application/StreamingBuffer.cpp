@@ -0,0 +1,82 @@
+#include "StreamingBuffer.hpp"
+
+#include <assert.h>
+#include <cstring>
+
+StreamingBuffer::StreamingBuffer(const u32 segmentSize, const u32 segmentCount, const char* debugName)
+	: segmentSize(segmentSize), segmentCount(segmentCount), fences(segmentCount, nullptr)
+{
+	assert(segmentCount > 0);
+	const auto size = static_cast<GLsizeiptr>(segmentSize) * segmentCount;
+	const auto flags = GLbitfield{ GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT };
+
+	glCreateBuffers(1, &buffer.nativeHandle);
+	glObjectLabel(GL_BUFFER, buffer.nativeHandle, glLabel(debugName));
+	glNamedBufferStorage(buffer.nativeHandle, size, nullptr, flags);
+	buffer.mappedPtr = glMapNamedBufferRange(buffer.nativeHandle, 0, size, flags);
+}
+
+StreamingBuffer::~StreamingBuffer()
+{
+	for (auto fence : fences)
+	{
+		if (fence)
+		{
+			glDeleteSync(fence);
+		}
+	}
+	glUnmapNamedBuffer(buffer.nativeHandle);
+	glDeleteBuffers(1, &buffer.nativeHandle);
+}
+
+StreamingBuffer::Allocation StreamingBuffer::Allocate(const u32 size, const u32 alignment)
+{
+	assert(size <= segmentSize);
+	assert(alignment > 0);
+
+	auto alignedHead = (head + alignment - 1) / alignment * alignment;
+	if (alignedHead + size > segmentSize)
+	{
+		// the segment being left may hold allocations of the current pass that the caller fences only later, on
+		// the segment it ends up in
+		Fence();
+		currentSegment = (currentSegment + 1) % segmentCount;
+		WaitForSegment(currentSegment);
+		alignedHead = 0;
+	}
+	head = alignedHead + size;
+	allocatedBytes += size;
+
+	const auto offset = currentSegment * segmentSize + alignedHead;
+	return Allocation{ offset, static_cast<u8*>(buffer.mappedPtr) + offset };
+}
+
+void StreamingBuffer::Fence()
+{
+	auto& fence = fences[currentSegment];
+	if (fence)
+	{
+		glDeleteSync(fence);
+	}
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void StreamingBuffer::WaitForSegment(const u32 segment)
+{
+	auto& fence = fences[segment];
+	if (not fence)
+	{
+		return;
+	}
+
+	constexpr auto timeout = GLuint64{ 1'000'000'000 };
+	auto result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+	while (result == GL_TIMEOUT_EXPIRED)
+	{
+		result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+	}
+	assert(result != GL_WAIT_FAILED);
+
+	glDeleteSync(fence);
+	fence = nullptr;
+}
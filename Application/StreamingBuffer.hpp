@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+
+#include "Common.hpp"
+
+struct Buffer
+{
+	GLuint nativeHandle{};
+	void* mappedPtr{ nullptr };
+};
+
+/*
+	Persistently mapped ring of segmentCount equally sized segments. Allocations are taken linearly from the current
+	segment; when it runs full the ring fences the segment it leaves, moves on to the next one and waits for the
+	fence that guards it. Fence() has to be called after the commands reading the allocations are issued, it
+	(re)places the fence of the current segment. Because of the fence on wrap, the commands reading an allocation
+	have to be issued before the next Allocate call; data read by a single draw belongs into a single allocation.
+	With three segments the cpu can write one segment while the gpu still reads the other two, so several
+	Begin/End pairs per frame never have to wait for the driver.
+*/
+struct StreamingBuffer
+{
+	struct Allocation
+	{
+		u32 offset;
+		void* data;
+	};
+
+	StreamingBuffer(const u32 segmentSize, const u32 segmentCount, const char* debugName);
+	~StreamingBuffer();
+
+	StreamingBuffer(const StreamingBuffer&) = delete;
+	StreamingBuffer& operator=(const StreamingBuffer&) = delete;
+
+	Allocation Allocate(const u32 size, const u32 alignment);
+	void Fence();
+
+	u32 GetSegmentSize() const
+	{
+		return segmentSize;
+	}
+	// sum of the allocated sizes since construction, without alignment padding
+	u64 GetAllocatedBytes() const
+	{
+		return allocatedBytes;
+	}
+
+	Buffer buffer{};
+
+private:
+	void WaitForSegment(const u32 segment);
+
+	u32 segmentSize{};
+	u32 segmentCount{};
+	u32 currentSegment{ 0 };
+	u32 head{ 0 };
+	u64 allocatedBytes{ 0 };
+	std::vector<GLsync> fences;
+};
@@ -0,0 +1,117 @@
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+#include <assert.h>
+
+WorkerPool::WorkerPool(const u32 workerCount)
+{
+	workers.reserve(workerCount);
+	for (auto i = u32{ 0 }; i < workerCount; i++)
+	{
+		workers.emplace_back([this]() { WorkerLoop(); });
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		auto lock = std::unique_lock{ mutex };
+		stopping = true;
+	}
+	wakeUp.notify_all();
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void WorkerPool::ParallelFor(const u32 count, const u32 chunkSize, const RangeJob& job)
+{
+	assert(chunkSize > 0);
+	if (count == 0)
+	{
+		return;
+	}
+	if (workers.empty() or count <= chunkSize)
+	{
+		job(0, count);
+		return;
+	}
+
+	{
+		auto lock = std::unique_lock{ mutex };
+		// workers that joined the previous loop late have to leave before its state is reused
+		finished.wait(lock, [this]() { return activeWorkers == 0; });
+		currentJob = &job;
+		itemCount = count;
+		itemsPerChunk = chunkSize;
+		chunkCount = (count + chunkSize - 1) / chunkSize;
+		nextChunk.store(0, std::memory_order_relaxed);
+		finishedChunks = 0;
+		generation++;
+	}
+	wakeUp.notify_all();
+
+	RunChunks(job);
+
+	auto lock = std::unique_lock{ mutex };
+	finished.wait(lock, [this]() { return finishedChunks == chunkCount and activeWorkers == 0; });
+	currentJob = nullptr;
+}
+
+void WorkerPool::RunChunks(const RangeJob& job)
+{
+	auto completed = u32{ 0 };
+	for (auto chunk = nextChunk.fetch_add(1); chunk < chunkCount; chunk = nextChunk.fetch_add(1))
+	{
+		const auto first = chunk * itemsPerChunk;
+		const auto last = std::min(first + itemsPerChunk, itemCount);
+		job(first, last);
+		completed++;
+	}
+
+	if (completed > 0)
+	{
+		auto lock = std::unique_lock{ mutex };
+		finishedChunks += completed;
+	}
+	finished.notify_all();
+}
+
+void WorkerPool::WorkerLoop()
+{
+	auto seenGeneration = u64{ 0 };
+	while (true)
+	{
+		const RangeJob* job = nullptr;
+		{
+			auto lock = std::unique_lock{ mutex };
+			wakeUp.wait(lock, [&]() { return stopping or generation != seenGeneration; });
+			if (stopping)
+			{
+				return;
+			}
+			seenGeneration = generation;
+			job = currentJob;
+			if (not job)
+			{
+				continue;
+			}
+			activeWorkers++;
+		}
+
+		RunChunks(*job);
+
+		{
+			auto lock = std::unique_lock{ mutex };
+			activeWorkers--;
+		}
+		finished.notify_all();
+	}
+}
+
+WorkerPool& GetWorkerPool()
+{
+	static auto pool = WorkerPool{ std::max(std::thread::hardware_concurrency(), 1u) - 1 };
+	return pool;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Common.hpp"
+
+/*
+	Small fork-join pool for data parallel loops. ParallelFor() splits [0, count) into ranges of chunkSize items,
+	hands them out to the workers and the calling thread, and returns once every range is done. Only one
+	ParallelFor() may run at a time.
+*/
+struct WorkerPool
+{
+	using RangeJob = std::function<void(const u32 first, const u32 last)>;
+
+	explicit WorkerPool(const u32 workerCount);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	void ParallelFor(const u32 count, const u32 chunkSize, const RangeJob& job);
+
+	// workers plus the calling thread
+	u32 GetThreadCount() const
+	{
+		return static_cast<u32>(workers.size()) + 1;
+	}
+
+private:
+	void WorkerLoop();
+	void RunChunks(const RangeJob& job);
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	std::condition_variable finished;
+
+	const RangeJob* currentJob{ nullptr };
+	u32 itemCount{ 0 };
+	u32 itemsPerChunk{ 1 };
+	u32 chunkCount{ 0 };
+	std::atomic<u32> nextChunk{ 0 };
+	u32 finishedChunks{ 0 };
+	u32 activeWorkers{ 0 };
+	u64 generation{ 0 };
+	bool stopping{ false };
+};
+
+// process wide pool with one worker less than hardware threads, the thread calling ParallelFor() is the last one
+WorkerPool& GetWorkerPool();
@@ -1,17 +1,101 @@
 #version 460
+#extension GL_EXT_nonuniform_qualifier : enable
 
 in block
 {
 	vec2 Texcoord;
 	vec3 Color;
+	flat float TextureLayer;
+	flat float Coverage;
+	flat float AlphaCutoff;
+	flat uint BatchIndex;
+	flat int TextureSlot;
 } In;
 
-layout(binding = 0) uniform sampler2D basicTexture;
+layout(std140, binding = 0) uniform spriteBatchConstants
+{
+	vec2 viewportSize;
+	uint vertexPulling;
+	uint premultipliedAlpha;
+	mat4 transform;
+	uint debugView;
+	uint depthTesting;
+} SpriteBatchConstants;
+
+layout(binding = 0) uniform sampler2DArray basicTextures[SPRITE_TEXTURE_SLOT_COUNT];
 layout(location = 0) out vec4 Color;
 
+/*
+	The slot is flat per draw but fragments of different draws of a multi draw can share a wave, so it is not
+	dynamically uniform. Without nonuniformEXT every case indexes the array with a constant instead.
+*/
+vec4 SampleSpriteTexture(int slot, vec3 uv)
+{
+#ifdef GL_EXT_nonuniform_qualifier
+	return texture(basicTextures[nonuniformEXT(slot)], uv);
+#else
+#if SPRITE_TEXTURE_SLOT_COUNT != 16
+#error the cases below must cover SPRITE_TEXTURE_SLOT_COUNT
+#endif
+	switch (slot)
+	{
+	case 0: return texture(basicTextures[0], uv);
+	case 1: return texture(basicTextures[1], uv);
+	case 2: return texture(basicTextures[2], uv);
+	case 3: return texture(basicTextures[3], uv);
+	case 4: return texture(basicTextures[4], uv);
+	case 5: return texture(basicTextures[5], uv);
+	case 6: return texture(basicTextures[6], uv);
+	case 7: return texture(basicTextures[7], uv);
+	case 8: return texture(basicTextures[8], uv);
+	case 9: return texture(basicTextures[9], uv);
+	case 10: return texture(basicTextures[10], uv);
+	case 11: return texture(basicTextures[11], uv);
+	case 12: return texture(basicTextures[12], uv);
+	case 13: return texture(basicTextures[13], uv);
+	case 14: return texture(basicTextures[14], uv);
+	default: return texture(basicTextures[15], uv);
+	}
+#endif
+}
+
+// must match SpriteDebugView
+const uint debugViewOverdraw = 1u;
+const uint debugViewBatches = 2u;
+
+// well spread hues for consecutive batch indices
+vec3 BatchColor(uint batchIndex)
+{
+	float hue = fract(float(batchIndex) * 0.618034);
+	return clamp(abs(fract(hue + vec3(0.0, 2.0 / 3.0, 1.0 / 3.0)) * 6.0 - 3.0) - 1.0, 0.0, 1.0);
+}
+
 void main()
 {
-	vec4 textureColor = texture(basicTexture, In.Texcoord).rgba;
+	vec4 textureColor = SampleSpriteTexture(In.TextureSlot, vec3(In.Texcoord, In.TextureLayer));
+#ifndef SPRITE_OPAQUE
+	// cutout sprites are alpha tested, their batches write depth; opaque ones are drawn by a variant without the
+	// discard, so their early depth test stays on
+	if (textureColor.a < In.AlphaCutoff)
+	{
+		discard;
+	}
+#endif
+	if (SpriteBatchConstants.debugView == debugViewOverdraw)
+	{
+		// counted with additive blending into the r32f target
+		Color = vec4(1.0, 0.0, 0.0, 0.0);
+		return;
+	}
 	textureColor.rgb = textureColor.rgb * In.Color;
+	if (SpriteBatchConstants.debugView == debugViewBatches)
+	{
+		textureColor.rgb = BatchColor(In.BatchIndex);
+	}
+	if (SpriteBatchConstants.premultipliedAlpha != 0u)
+	{
+		// the textures hold straight alpha
+		textureColor = vec4(textureColor.rgb * textureColor.a, textureColor.a * In.Coverage);
+	}
 	Color = vec4(textureColor);
 }
\ No newline at end of file
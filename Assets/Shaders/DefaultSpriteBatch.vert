@@ -3,13 +3,41 @@
 layout(location = 0) in vec2 Position;
 layout(location = 1) in vec2 Texcoord;
 layout(location = 2) in vec3 Color;
+layout(location = 3) in float TextureLayer;
 
-layout(binding = 0) uniform spriteBatchConstants
+layout(std140, binding = 0) uniform spriteBatchConstants
 {
 	vec2 viewportSize;
+	uint vertexPulling;
+	uint premultipliedAlpha;
 	mat4 transform;
+	uint debugView;
+	uint depthTesting;
 } SpriteBatchConstants;
 
+// must match SpriteBatch::SpriteRecord
+struct SpriteRecord
+{
+	vec4 destination;
+	uvec2 uvRect;
+	uint color;
+	uint flags; // see SpriteBatch::additiveFlagBit
+	vec2 origin;
+	float rotation;
+	float layer;
+};
+
+layout(std430, binding = 0) readonly buffer spriteRecords
+{
+	SpriteRecord Sprites[];
+};
+
+// one layer per cpu expanded quad with depth testing, see SpriteBatch::GenerateSpriteLayers()
+layout(std430, binding = 1) readonly buffer spriteLayers
+{
+	float SpriteLayers[];
+};
+
 out gl_PerVertex
 {
 	vec4 gl_Position;
@@ -19,6 +47,11 @@ out block
 {
 	vec2 Texcoord;
 	vec3 Color;
+	flat float TextureLayer;
+	flat float Coverage;
+	flat float AlphaCutoff;
+	flat uint BatchIndex;
+	flat int TextureSlot;
 } Out;
 
 void main()
@@ -26,12 +59,60 @@ void main()
 	float w = SpriteBatchConstants.viewportSize.x;
 	float h = SpriteBatchConstants.viewportSize.y;
 
-	vec2 p = vec2(mat3(SpriteBatchConstants.transform) * vec3(Position.xy, 1.0));
+	vec2 position = Position;
+	vec2 texcoord = Texcoord;
+	vec3 color = Color;
+	// see SpriteBatch::vertexLayerShift
+	uint layer = uint(TextureLayer) >> SPRITE_VERTEX_LAYER_SHIFT;
+	bool additive = (uint(TextureLayer) & SPRITE_VERTEX_ADDITIVE_BIT) != 0u;
+	float spriteLayer = 0.0;
+
+	if (SpriteBatchConstants.vertexPulling != 0u)
+	{
+		// corners are ordered top right, top left, bottom right, bottom left, like the cpu expanded quads
+		SpriteRecord sprite = Sprites[gl_VertexID / 4];
+		int corner = gl_VertexID % 4;
+		vec2 cornerMask = vec2((corner & 1) == 0 ? 1.0 : 0.0, corner >> 1);
+
+		vec4 uv = vec4(unpackUnorm2x16(sprite.uvRect.x), unpackUnorm2x16(sprite.uvRect.y));
+		uv.xz = (sprite.flags & SPRITE_FLIP_HORIZONTAL_BIT) != 0u ? uv.zx : uv.xz;
+		uv.yw = (sprite.flags & SPRITE_FLIP_VERTICAL_BIT) != 0u ? uv.wy : uv.yw;
+
+		vec2 extent = sprite.destination.zw + vec2(1.0, 1.0); // TODO: investigate
+		vec2 local = cornerMask * extent - sprite.origin;
+		float s = sin(sprite.rotation);
+		float c = cos(sprite.rotation);
+		position = sprite.destination.xy + sprite.origin + vec2(c * local.x - s * local.y, s * local.x + c * local.y);
+		texcoord = mix(uv.xy, uv.zw, cornerMask);
+		color = unpackUnorm4x8(sprite.color).rgb;
+		layer = sprite.flags >> SPRITE_TEXTURE_LAYER_SHIFT;
+		additive = (sprite.flags & SPRITE_ADDITIVE_FLAG_BIT) != 0u;
+		spriteLayer = sprite.layer;
+	}
+	else if (SpriteBatchConstants.depthTesting != 0u)
+	{
+		// the vertex buffer binding and the layer buffer start at the same quad
+		spriteLayer = SpriteLayers[gl_VertexID / 4];
+	}
+
+	vec2 p = vec2(mat3(SpriteBatchConstants.transform) * vec3(position.xy, 1.0));
 
 	p = p/vec2(w,h);
 	p.y = 1.0-p.y;
 	p = p*2.0f - vec2(1.0f, 1.0f);
-	gl_Position = vec4(p, 0.0, 1.0);
-	Out.Texcoord = Texcoord;
-	Out.Color = Color.rgb;
-}
\ No newline at end of file
+	// the depth buffer is cleared to 0, so layer 0 maps to the largest depth and the depth test passes greater or
+	// equal values
+	float depth = SpriteBatchConstants.depthTesting != 0u ? 1.0 - clamp(spriteLayer, 0.0, 1.0) : 0.0;
+	gl_Position = vec4(p, depth * 2.0 - 1.0, 1.0);
+	Out.Texcoord = texcoord;
+	Out.Color = color.rgb;
+	Out.TextureLayer = float(layer);
+	// additive sprites add their color without covering the destination
+	Out.Coverage = additive ? 0.0 : 1.0;
+	// draw parameters of the batch, see SpriteBatch::drawAlphaTestBit: alpha test bit, texture slot, batch index
+	uint drawParameters = uint(gl_BaseInstance);
+	Out.AlphaCutoff = (drawParameters & SPRITE_DRAW_ALPHA_TEST_BIT) != 0u ? 0.5 : 0.0;
+	Out.BatchIndex = drawParameters >> SPRITE_DRAW_BATCH_INDEX_SHIFT;
+	// the draws of a multi draw share the texture units, the batch names its own
+	Out.TextureSlot = int((drawParameters >> SPRITE_DRAW_TEXTURE_SLOT_SHIFT) & SPRITE_DRAW_TEXTURE_SLOT_MASK);
+}
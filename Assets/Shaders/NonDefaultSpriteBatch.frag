@@ -1,17 +1,53 @@
 #version 460
+#extension GL_EXT_nonuniform_qualifier : enable
+
+// custom effect shaders only cover the cpuExpansion submission with straight alpha, see SpriteBatch::Begin()
 
 in block
 {
 	vec2 Texcoord;
 	vec3 Color;
+	flat float TextureLayer;
+	flat int TextureSlot;
 } In;
 
-layout(binding = 0) uniform sampler2D basicTexture;
+layout(binding = 0) uniform sampler2DArray basicTextures[SPRITE_TEXTURE_SLOT_COUNT];
 layout(location = 0) out vec4 Color;
 
+// copy of the one in DefaultSpriteBatch.frag, the slot is not dynamically uniform
+vec4 SampleSpriteTexture(int slot, vec3 uv)
+{
+#ifdef GL_EXT_nonuniform_qualifier
+	return texture(basicTextures[nonuniformEXT(slot)], uv);
+#else
+#if SPRITE_TEXTURE_SLOT_COUNT != 16
+#error the cases below must cover SPRITE_TEXTURE_SLOT_COUNT
+#endif
+	switch (slot)
+	{
+	case 0: return texture(basicTextures[0], uv);
+	case 1: return texture(basicTextures[1], uv);
+	case 2: return texture(basicTextures[2], uv);
+	case 3: return texture(basicTextures[3], uv);
+	case 4: return texture(basicTextures[4], uv);
+	case 5: return texture(basicTextures[5], uv);
+	case 6: return texture(basicTextures[6], uv);
+	case 7: return texture(basicTextures[7], uv);
+	case 8: return texture(basicTextures[8], uv);
+	case 9: return texture(basicTextures[9], uv);
+	case 10: return texture(basicTextures[10], uv);
+	case 11: return texture(basicTextures[11], uv);
+	case 12: return texture(basicTextures[12], uv);
+	case 13: return texture(basicTextures[13], uv);
+	case 14: return texture(basicTextures[14], uv);
+	default: return texture(basicTextures[15], uv);
+	}
+#endif
+}
+
 void main()
 {
-	vec4 textureColor = texture(basicTexture, In.Texcoord).rgba;
+	vec4 textureColor = SampleSpriteTexture(In.TextureSlot, vec3(In.Texcoord, In.TextureLayer));
 	textureColor.rgb = textureColor.rgb * In.Color;
 	Color = vec4(textureColor);
 }
\ No newline at end of file
@@ -1,16 +1,19 @@
 #version 460
 
+// custom effect shaders only cover the cpuExpansion submission with straight alpha, see SpriteBatch::Begin()
+
 layout(location = 0) in vec2 Position;
 layout(location = 1) in vec2 Texcoord;
 layout(location = 2) in vec3 Color;
+layout(location = 3) in float TextureLayer;
 
-layout(binding = 0) uniform spriteBatchConstants
+layout(std140, binding = 0) uniform spriteBatchConstants
 {
 	vec2 viewportSize;
 	mat4 transform;
 } SpriteBatchConstants;
 
-layout(binding = 1) uniform spriteBatchConstants
+layout(std140, binding = 1) uniform lightConstants
 {
 	vec2 pointLightPosition;
 	vec4 pointLightColor;
@@ -25,6 +28,8 @@ out block
 {
 		vec2 Texcoord;
 		vec3 Color;
+		flat float TextureLayer;
+		flat int TextureSlot;
 } Out;
 
 void main()
@@ -40,4 +45,8 @@ void main()
 	gl_Position = vec4(p, 0.0, 1.0);
 	Out.Texcoord = Texcoord;
 	Out.Color = Color.rgb;
+	// see SpriteBatch::vertexLayerShift
+	Out.TextureLayer = float(uint(TextureLayer) >> SPRITE_VERTEX_LAYER_SHIFT);
+	// see SpriteBatch::drawTextureSlotShift
+	Out.TextureSlot = int((uint(gl_BaseInstance) >> SPRITE_DRAW_TEXTURE_SLOT_SHIFT) & SPRITE_DRAW_TEXTURE_SLOT_MASK);
 }
\ No newline at end of file
@@ -0,0 +1,22 @@
+#version 460
+
+// fragment counts written by SpriteBatch in the overdraw debug view
+layout(binding = 0) uniform sampler2D overdrawCounts;
+
+layout(location = 0, index = 0) out vec4 color;
+
+// counts at or above this are drawn white
+const float maxOverdraw = 8.0;
+
+void main()
+{
+	float count = texelFetch(overdrawCounts, ivec2(gl_FragCoord.xy), 0).r;
+	float t = clamp(count / maxOverdraw, 0.0, 1.0);
+
+	// black for untouched pixels, then blue, green, yellow, red and white
+	vec3 heat = mix(vec3(0.0, 0.0, 0.5), vec3(0.0, 0.8, 0.0), smoothstep(0.0, 0.25, t));
+	heat = mix(heat, vec3(1.0, 1.0, 0.0), smoothstep(0.25, 0.5, t));
+	heat = mix(heat, vec3(1.0, 0.0, 0.0), smoothstep(0.5, 0.75, t));
+	heat = mix(heat, vec3(1.0, 1.0, 1.0), smoothstep(0.75, 1.0, t));
+	color = vec4(count > 0.0 ? heat : vec3(0.0), 1.0);
+}